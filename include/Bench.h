@@ -0,0 +1,205 @@
+// Bench.h
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+#include "Keymap.h"
+#include "HidReport.h"
+#include "EventQueue.h"
+#include "KeyDispatch.h"
+#include "KeyReporter.h"
+
+// ================================
+// Scan microbenchmarks
+//
+// Runs the scan's stages in isolation on a synthetic matrix, so builds can
+// be compared on identical work:
+//   matrix    row select, settle and column read (real pins, result unused)
+//   debounce  debouncer update of every row
+//   dispatch  layer lookup and event queueing of the committed changes
+//   report    events -> boot report slots (nothing is sent)
+// Dispatch and report run the firmware's own KeyDispatcher and KeyReporter,
+// so the numbers include replays and modifier reference counting.
+//
+// Inputs are a pure function of the scenario and the iteration number, and
+// every iteration advances the debounce clock by one scan period. The
+// caller supplies the clock that times the stages.
+// ================================
+
+enum BenchScenario : uint8_t {
+  BENCH_IDLE,      // nothing pressed
+  BENCH_ONE_KEY,   // first populated key, pressed and released in turn
+  BENCH_TEN_KEYS,  // first ten populated keys, pressed and released together
+  BENCH_CHATTER,   // every populated key bouncing at random each scan
+  BENCH_SCENARIOS,
+};
+
+inline const char *benchScenarioName(BenchScenario s) {
+  static const char *const names[BENCH_SCENARIOS] = {"idle", "one", "ten", "chatter"};
+  return s < BENCH_SCENARIOS ? names[s] : "?";
+}
+
+enum BenchStage : uint8_t {
+  BENCH_MATRIX,
+  BENCH_DEBOUNCE,
+  BENCH_DISPATCH,
+  BENCH_REPORT,
+  BENCH_STAGES,
+};
+
+struct BenchResult {
+  uint32_t iterations;
+  uint32_t events;                 // key events accepted by the queue
+  uint32_t reports;                // boot reports that changed
+  uint64_t ticks[BENCH_STAGES];    // clock ticks per stage, summed over all iterations
+};
+
+// Held keys flip every this many iterations (longer than any debounce
+// window), so presses and releases both commit
+static const uint32_t BENCH_HOLD_ITERATIONS = 64;
+
+// ================================
+// Synthetic matrix
+// ================================
+
+class BenchMatrix {
+public:
+  // Picks the scenario's keys among the populated positions, row by row
+  void begin(BenchScenario s, const uint16_t (&validRows)[NUM_ROWS]) {
+    scenario = s;
+    uint16_t want = (s == BENCH_ONE_KEY) ? 1 : (s == BENCH_TEN_KEYS) ? 10 : (s == BENCH_CHATTER) ? 0xFFFF : 0;
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      keys[r] = 0;
+      for (uint8_t c = 0; c < NUM_COLS && want; ++c) {
+        if (validRows[r] & (1u << c)) {
+          keys[r] |= (uint16_t)(1u << c);
+          --want;
+        }
+      }
+    }
+  }
+
+  // Raw row word (bit c = pressed) at iteration i
+  uint16_t row(uint8_t r, uint32_t i) const {
+    switch (scenario) {
+      case BENCH_ONE_KEY:
+      case BENCH_TEN_KEYS: return ((i / BENCH_HOLD_ITERATIONS) & 1) ? 0 : keys[r];
+      case BENCH_CHATTER:  return (uint16_t)(noise(i, r) & keys[r]);
+      default:             return 0;
+    }
+  }
+
+private:
+  // xorshift32 of the iteration and row: the same bounces on every run
+  static uint32_t noise(uint32_t i, uint8_t r) {
+    uint32_t x = (i * 0x9E3779B9u) ^ ((uint32_t)(r + 1) * 0x85EBCA6Bu);
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+  }
+
+  BenchScenario scenario = BENCH_IDLE;
+  uint16_t keys[NUM_ROWS] = {};
+};
+
+// ================================
+// Stage runner
+//
+// Owns its own debouncer, dispatcher, queue and reporter, so a run leaves
+// the live keyboard state alone. Debouncer is the firmware's debounce
+// engine type and QUEUE_SIZE its event queue size; Clock is any callable
+// returning a free-running uint32_t count.
+// ================================
+
+template <class Debouncer, uint16_t QUEUE_SIZE>
+class ScanBench {
+public:
+  ScanBench() : keys(events) {}
+
+  template <class Clock>
+  void run(BenchScenario s, uint32_t iterations, uint32_t scanPeriodUs, const ResolvedKeymap &km,
+           const uint32_t (&settleCycles)[NUM_ROWS], Clock clock, BenchResult &out) {
+    debouncer.reset();
+    keys.begin(km);
+    KeyEvent ev;
+    while (events.pop(ev)) {
+    }
+    events.resetStats();
+    // Start from an empty report the host has already seen, whatever the
+    // previous run left held
+    reporter.reset();
+    KeyboardReport rep;
+    reporter.takeChanged(rep);
+    matrix.begin(s, km.validRows);
+
+    out.iterations = iterations;
+    out.reports = 0;
+    for (uint8_t st = 0; st < BENCH_STAGES; ++st) out.ticks[st] = 0;
+
+    for (uint32_t i = 0; i < iterations; ++i) {
+      const uint32_t nowMs = (uint32_t)((uint64_t)i * scanPeriodUs / 1000);
+
+      // Matrix: the scan's select/settle/read sequence
+      uint32_t t = clock();
+      selectRow(0);
+      uint32_t selectedAt = cycleCount();
+      for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+        waitSettle(selectedAt, settleCycles[r]);
+        (void)readColumns();
+        releaseRow(r);
+        if (r + 1 < NUM_ROWS) {
+          selectRow(r + 1);
+          selectedAt = cycleCount();
+        }
+      }
+      uint32_t done = clock();
+      out.ticks[BENCH_MATRIX] += done - t;
+
+      uint16_t raw[NUM_ROWS];
+      for (uint8_t r = 0; r < NUM_ROWS; ++r) raw[r] = matrix.row(r, i) & km.validRows[r];
+
+      // Debounce
+      uint16_t flipped[NUM_ROWS];
+      t = clock();
+      for (uint8_t r = 0; r < NUM_ROWS; ++r) flipped[r] = debouncer.update(r, raw[r], nowMs);
+      done = clock();
+      out.ticks[BENCH_DEBOUNCE] += done - t;
+
+      // Dispatch
+      t = clock();
+      keys.beginScan();
+      for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+        const uint16_t state = debouncer.state(r);
+        for (uint16_t f = flipped[r]; f; f &= (uint16_t)(f - 1)) {
+          const uint8_t c = (uint8_t)__builtin_ctz(f);
+          if ((state >> c) & 1) keys.press(r, c, i);
+          else keys.release(r, c, i);
+        }
+      }
+      done = clock();
+      out.ticks[BENCH_DISPATCH] += done - t;
+
+      // Report
+      t = clock();
+      while (events.pop(ev)) reporter.apply(ev);
+      if (reporter.takeChanged(rep)) ++out.reports;
+      done = clock();
+      out.ticks[BENCH_REPORT] += done - t;
+    }
+    out.events = events.getStats().pushed;
+  }
+
+  // Report state at the end of the last run
+  const ReportBuilder &report() const { return reporter.builder(); }
+
+private:
+  Debouncer debouncer;
+  SpscQueue<KeyEvent, QUEUE_SIZE> events;
+  KeyDispatcher<QUEUE_SIZE> keys;
+  KeyReporter reporter;
+  BenchMatrix matrix;
+};
+
+#endif // BENCH_H
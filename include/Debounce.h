@@ -0,0 +1,155 @@
+// Debounce.h
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+
+// ================================
+// Debounce engines
+//
+// Both engines work on packed row words (bit c = column c pressed) and
+// share one interface, so keyboardScan() picks one at compile time:
+//   update(row, raw, now) -> bits whose debounced state flipped
+//   state(row)            -> debounced row word
+//   clear(row)            -> forget held keys (panic/cleanup)
+//   idle()                -> no key held or mid-debounce, so all-zero rows
+//                            would change nothing
+// ================================
+
+// When an edge is reported
+enum DebouncePolicy : uint8_t {
+  DEBOUNCE_DEFER, // once raw has been stable for the debounce window
+  DEBOUNCE_EAGER, // on the first edge, then the key is ignored for the window
+};
+
+// Per-key timestamps, with separate policies for press and release edges
+template <uint32_t DEBOUNCE_MS,
+          DebouncePolicy PRESS = DEBOUNCE_DEFER,
+          DebouncePolicy RELEASE = DEBOUNCE_DEFER>
+class TimestampDebouncer {
+public:
+  void reset() {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      lastRaw[r] = 0;
+      debounced[r] = 0;
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        lastChange[r][c] = 0;
+        lastCommit[r][c] = 0u - DEBOUNCE_MS; // no lockout at boot
+      }
+    }
+  }
+
+  uint16_t update(uint8_t row, uint16_t raw, uint32_t now) {
+    // Raw changed: reset timers of the changed keys only
+    uint16_t changed = raw ^ lastRaw[row];
+    if (changed) {
+      lastRaw[row] = raw;
+      while (changed) {
+        lastChange[row][__builtin_ctz(changed)] = now;
+        changed &= (uint16_t)(changed - 1);
+      }
+    }
+
+    // Keys whose debounced state differs from raw; nothing to do for a settled row
+    uint16_t pending = raw ^ debounced[row];
+    uint16_t flipped = 0;
+    while (pending) {
+      const uint8_t c = (uint8_t)__builtin_ctz(pending);
+      const uint16_t bit = (uint16_t)(1u << c);
+      pending &= (uint16_t)(pending - 1);
+
+      // Eager edges only wait out the lockout of the previous commit
+      const bool eager = (raw & bit) ? (PRESS == DEBOUNCE_EAGER) : (RELEASE == DEBOUNCE_EAGER);
+      const uint32_t since = eager ? lastCommit[row][c] : lastChange[row][c];
+      if ((now - since) >= DEBOUNCE_MS) {
+        flipped |= bit;
+        lastCommit[row][c] = now;
+      }
+    }
+    debounced[row] ^= flipped;
+    return flipped;
+  }
+
+  uint16_t state(uint8_t row) const { return debounced[row]; }
+  void clear(uint8_t row) { debounced[row] = 0; }
+
+  bool idle() const {
+    uint16_t any = 0;
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) any |= (uint16_t)(lastRaw[r] | debounced[r]);
+    return any == 0;
+  }
+
+private:
+  uint16_t lastRaw[NUM_ROWS];              // previous raw for debounce timing
+  uint16_t debounced[NUM_ROWS];            // stable state
+  uint32_t lastChange[NUM_ROWS][NUM_COLS]; // time of last raw change
+  uint32_t lastCommit[NUM_ROWS][NUM_COLS]; // start of the eager lockout window
+};
+
+// Bits needed for a counter that must reach n
+constexpr uint8_t counterBits(uint32_t n) {
+  uint8_t bits = 1;
+  while ((1u << bits) <= n) ++bits;
+  return bits;
+}
+
+// Bit-sliced integrator ("vertical counter"): plane b holds bit b of every
+// key's counter in a row, so one ripple-carry pass of AND/XOR advances all
+// 14 counters at once. A counter runs while raw differs from the debounced
+// state and resets when they agree; the key flips on the SAMPLES-th
+// consecutive differing sample.
+template <uint8_t SAMPLES>
+class VerticalCounterDebouncer {
+public:
+  static_assert(SAMPLES >= 1, "vertical counter needs at least one sample");
+  static constexpr uint8_t BITS = counterBits(SAMPLES);
+
+  void reset() {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) clear(r);
+  }
+
+  uint16_t update(uint8_t row, uint16_t raw, uint32_t /*now*/) {
+    const uint16_t delta = raw ^ debounced[row];
+    uint16_t *cnt = planes[row];
+
+    // Increment where raw differs, reset elsewhere; collect counters == SAMPLES
+    uint16_t carry = delta;
+    uint16_t reached = delta;
+    for (uint8_t b = 0; b < BITS; ++b) {
+      const uint16_t v = cnt[b];
+      cnt[b] = (uint16_t)((v ^ carry) & delta);
+      carry &= v;
+      reached &= ((SAMPLES >> b) & 1) ? cnt[b] : (uint16_t)~cnt[b];
+    }
+
+    // Keys that reached the count flip and restart
+    if (reached) {
+      debounced[row] ^= reached;
+      for (uint8_t b = 0; b < BITS; ++b) cnt[b] &= (uint16_t)~reached;
+    }
+    return reached;
+  }
+
+  uint16_t state(uint8_t row) const { return debounced[row]; }
+
+  void clear(uint8_t row) {
+    debounced[row] = 0;
+    for (uint8_t b = 0; b < BITS; ++b) planes[row][b] = 0;
+  }
+
+  bool idle() const {
+    uint16_t any = 0;
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      any |= debounced[r];
+      for (uint8_t b = 0; b < BITS; ++b) any |= planes[r][b];
+    }
+    return any == 0;
+  }
+
+private:
+  uint16_t debounced[NUM_ROWS];     // stable state
+  uint16_t planes[NUM_ROWS][BITS];  // counter bit planes
+};
+
+#endif // DEBOUNCE_H
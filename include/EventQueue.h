@@ -0,0 +1,97 @@
+// EventQueue.h
+#ifndef EVENTQUEUE_H
+#define EVENTQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// ================================
+// Key events, scan -> reporter
+// ================================
+
+enum KeyEventType : uint8_t {
+  KEY_EVENT_PRESS,
+  KEY_EVENT_RELEASE,
+  KEY_EVENT_RESET,    // drop everything held; presses of still-held keys follow
+};
+
+struct KeyEvent {
+  uint32_t cycles;   // cycle counter when the scan committed the change
+  uint32_t edge;     // cycle counter at the key's first raw edge (0: none, e.g. replays)
+  uint16_t scan;     // scan sequence number; one report per scan
+  uint16_t action;   // PackedAction the key was pressed with
+  uint8_t pos;       // row * NUM_COLS + col
+  uint8_t type;      // KeyEventType
+};
+
+// ================================
+// Single-producer/single-consumer ring
+//
+// The producer (scan interrupt) only writes head and the consumer (loop)
+// only writes tail, so neither side locks or waits: a full ring drops the
+// new item and counts it. Indices run freely and wrap at 16 bits; N must be
+// a power of two.
+//
+// Stats belong to the producer; read them with the producer held off.
+// ================================
+
+struct QueueStats {
+  uint32_t pushed;     // items accepted
+  uint32_t overflows;  // items dropped on a full ring
+  uint16_t highWater;  // most items ever waiting
+};
+
+template <typename T, uint16_t N>
+class SpscQueue {
+  static_assert(N >= 2 && N <= 0x8000 && (N & (N - 1)) == 0, "queue size must be a power of two");
+
+public:
+  // Producer
+  bool push(const T &item) {
+    const uint16_t h = head.load(std::memory_order_relaxed);
+    const uint16_t used = (uint16_t)(h - tail.load(std::memory_order_acquire));
+    if (used >= N) {
+      ++stats.overflows;
+      return false;
+    }
+    slots[h & (N - 1)] = item;
+    head.store((uint16_t)(h + 1), std::memory_order_release);
+    ++stats.pushed;
+    if (used + 1 > stats.highWater) stats.highWater = (uint16_t)(used + 1);
+    return true;
+  }
+
+  uint16_t freeSlots() const {
+    return (uint16_t)(N - (uint16_t)(head.load(std::memory_order_relaxed) -
+                                     tail.load(std::memory_order_acquire)));
+  }
+
+  // Consumer
+  bool pop(T &out) {
+    const uint16_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    out = slots[t & (N - 1)];
+    tail.store((uint16_t)(t + 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+  }
+
+  void resetStats() {
+    stats.pushed = 0;
+    stats.overflows = 0;
+    stats.highWater = 0;
+  }
+
+  const QueueStats &getStats() const { return stats; }
+
+private:
+  T slots[N];
+  std::atomic<uint16_t> head{0};
+  std::atomic<uint16_t> tail{0};
+  QueueStats stats = {};
+};
+
+#endif // EVENTQUEUE_H
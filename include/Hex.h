@@ -0,0 +1,41 @@
+// Hex.h
+#ifndef HEX_H
+#define HEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================================
+// Hex transport (serial commands, trace lines)
+// ================================
+
+inline int8_t hexNibble(char ch) {
+  return (ch >= '0' && ch <= '9') ? (int8_t)(ch - '0') :
+         (ch >= 'A' && ch <= 'F') ? (int8_t)(ch - 'A' + 10) :
+         (ch >= 'a' && ch <= 'f') ? (int8_t)(ch - 'a' + 10) :
+         -1;
+}
+
+// Decodes exactly 2 * len hex digits; false on a length mismatch or bad digit
+inline bool hexDecode(const char *hex, size_t hexLen, uint8_t *out, size_t len) {
+  if (hexLen != 2 * len) return false;
+  for (size_t i = 0; i < len; ++i) {
+    const int8_t hi = hexNibble(hex[2 * i]);
+    const int8_t lo = hexNibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) return false;
+    out[i] = (uint8_t)((hi << 4) | lo);
+  }
+  return true;
+}
+
+// Writes 2 * len uppercase digits and a terminator
+inline void hexEncode(const uint8_t *in, size_t len, char *out) {
+  static const char digits[] = "0123456789ABCDEF";
+  for (size_t i = 0; i < len; ++i) {
+    out[2 * i] = digits[in[i] >> 4];
+    out[2 * i + 1] = digits[in[i] & 0x0F];
+  }
+  out[2 * len] = '\0';
+}
+
+#endif // HEX_H
@@ -0,0 +1,132 @@
+// HidReport.h
+#ifndef HIDREPORT_H
+#define HIDREPORT_H
+
+#include <stdint.h>
+
+// ================================
+// HID keyboard usages
+// ================================
+
+// Modifier byte bits of the boot keyboard report
+static constexpr uint8_t HID_MOD_LCTRL  = 0x01;
+static constexpr uint8_t HID_MOD_LSHIFT = 0x02;
+static constexpr uint8_t HID_MOD_LALT   = 0x04;
+
+// Flag in hidUsageFor() results: the character also needs Shift
+static constexpr uint16_t HID_USAGE_SHIFT = 0x100;
+
+// US layout: printable ASCII -> usage (| HID_USAGE_SHIFT), 0 if unmapped
+constexpr uint16_t asciiUsage(char ch) {
+  return (ch >= 'a' && ch <= 'z') ? (uint16_t)(0x04 + (ch - 'a')) :
+         (ch >= 'A' && ch <= 'Z') ? (uint16_t)((0x04 + (ch - 'A')) | HID_USAGE_SHIFT) :
+         (ch >= '1' && ch <= '9') ? (uint16_t)(0x1E + (ch - '1')) :
+         (ch == '0')  ? 0x27 :
+         (ch == '\n') ? 0x28 :
+         (ch == '\t') ? 0x2B :
+         (ch == ' ')  ? 0x2C :
+         (ch == '-')  ? 0x2D :
+         (ch == '=')  ? 0x2E :
+         (ch == '[')  ? 0x2F :
+         (ch == ']')  ? 0x30 :
+         (ch == '\\') ? 0x31 :
+         (ch == ';')  ? 0x33 :
+         (ch == '\'') ? 0x34 :
+         (ch == '`')  ? 0x35 :
+         (ch == ',')  ? 0x36 :
+         (ch == '.')  ? 0x37 :
+         (ch == '/')  ? 0x38 :
+         (ch == '!')  ? (0x1E | HID_USAGE_SHIFT) :
+         (ch == '@')  ? (0x1F | HID_USAGE_SHIFT) :
+         (ch == '#')  ? (0x20 | HID_USAGE_SHIFT) :
+         (ch == '$')  ? (0x21 | HID_USAGE_SHIFT) :
+         (ch == '%')  ? (0x22 | HID_USAGE_SHIFT) :
+         (ch == '^')  ? (0x23 | HID_USAGE_SHIFT) :
+         (ch == '&')  ? (0x24 | HID_USAGE_SHIFT) :
+         (ch == '*')  ? (0x25 | HID_USAGE_SHIFT) :
+         (ch == '(')  ? (0x26 | HID_USAGE_SHIFT) :
+         (ch == ')')  ? (0x27 | HID_USAGE_SHIFT) :
+         (ch == '_')  ? (0x2D | HID_USAGE_SHIFT) :
+         (ch == '+')  ? (0x2E | HID_USAGE_SHIFT) :
+         (ch == '{')  ? (0x2F | HID_USAGE_SHIFT) :
+         (ch == '}')  ? (0x30 | HID_USAGE_SHIFT) :
+         (ch == '|')  ? (0x31 | HID_USAGE_SHIFT) :
+         (ch == ':')  ? (0x33 | HID_USAGE_SHIFT) :
+         (ch == '"')  ? (0x34 | HID_USAGE_SHIFT) :
+         (ch == '~')  ? (0x35 | HID_USAGE_SHIFT) :
+         (ch == '<')  ? (0x36 | HID_USAGE_SHIFT) :
+         (ch == '>')  ? (0x37 | HID_USAGE_SHIFT) :
+         (ch == '?')  ? (0x38 | HID_USAGE_SHIFT) :
+         0;
+}
+
+// Keymap key value (ASCII or Teensy KEY_* = 0xF000 | usage) -> usage, 0 if unmapped
+constexpr uint16_t hidUsageFor(uint16_t key) {
+  return ((key & 0xFF00) == 0xF000) ? (uint16_t)(key & 0xFF) :
+         (key < 0x80) ? asciiUsage((char)key) :
+         0;
+}
+
+// ================================
+// Boot keyboard report
+//
+// Press/release only edit this struct; the caller sends it once per scan
+// when it differs from the last report sent.
+//
+// Six key slots, as the core's keyboard interface sends them: a seventh
+// key is dropped until a slot frees up. NKRO is deferred; it needs its own
+// HID descriptor and endpoint in a project-local variant of the Teensy
+// core, with this report kept as the boot protocol fallback.
+// ================================
+
+static constexpr uint8_t HID_KEY_SLOTS = 6;
+
+struct KeyboardReport {
+  uint8_t mods;
+  uint8_t keys[HID_KEY_SLOTS];
+};
+
+class ReportBuilder {
+public:
+  void clear() {
+    current.mods = 0;
+    for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) current.keys[i] = 0;
+  }
+
+  void setMods(uint8_t bits) { current.mods |= bits; }
+  void clearMods(uint8_t bits) { current.mods &= (uint8_t)~bits; }
+
+  // Takes the first free slot; ignored if already down or all slots are taken
+  void pressKey(uint8_t usage) {
+    int8_t free = -1;
+    for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) {
+      if (current.keys[i] == usage) return;
+      if (free < 0 && current.keys[i] == 0) free = (int8_t)i;
+    }
+    if (free >= 0) current.keys[free] = usage;
+  }
+
+  void releaseKey(uint8_t usage) {
+    for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) {
+      if (current.keys[i] == usage) current.keys[i] = 0;
+    }
+  }
+
+  const KeyboardReport &report() const { return current; }
+
+  // Copies the report to out and marks it sent, if it changed since the last send
+  bool takeChanged(KeyboardReport &out) {
+    bool changed = (current.mods != sent.mods);
+    for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) changed |= (current.keys[i] != sent.keys[i]);
+    if (!changed) return false;
+    sent = current;
+    out = current;
+    return true;
+  }
+
+private:
+  KeyboardReport current = {};
+  KeyboardReport sent = {};
+};
+
+#endif // HIDREPORT_H
@@ -0,0 +1,108 @@
+// IdlePolicy.h
+#ifndef IDLEPOLICY_H
+#define IDLEPOLICY_H
+
+#include <stdint.h>
+
+// ================================
+// Idle (sleep until a column edge) policy
+//
+// Decides when the scanner may stop and sleep, and accounts wakes. The
+// firmware reports scans, the arming result and column edges; the policy
+// only keeps state.
+//
+//   SCANNING --quiet period--> arm (rows LOW, edge IRQs) --> SLEEPING
+//   SLEEPING --column edge--> WAKING --first scan--> SCANNING
+//
+// A column already LOW right after arming means an edge may have landed
+// before the interrupts were live, so the entry is aborted (missed edge).
+// ================================
+
+enum IdleState : uint8_t {
+  IDLE_SCANNING,
+  IDLE_SLEEPING,
+  IDLE_WAKING,
+};
+
+struct IdleStats {
+  uint32_t entries;     // times idle was entered
+  uint32_t wakes;       // column edges that ended idle
+  uint32_t missedEdges; // entries aborted by a column already LOW after arming
+  uint32_t maxWakeUs;   // worst edge-to-scan latency
+};
+
+class IdlePolicy {
+public:
+  // quietUs == 0 disables idle
+  void begin(uint32_t quietUs, uint32_t nowUs) {
+    quiet = quietUs;
+    lastActivity = nowUs;
+    state = IDLE_SCANNING;
+    resetStats();
+  }
+
+  // After every scan; activity = a key is held, settling or seen by the probe
+  void onScan(bool activity, uint32_t nowUs) {
+    if (state == IDLE_WAKING) {
+      const uint32_t latency = nowUs - wokeAt;
+      if (latency > stats.maxWakeUs) stats.maxWakeUs = latency;
+      state = IDLE_SCANNING;
+      activity = true;
+    }
+    if (activity) lastActivity = nowUs;
+  }
+
+  bool shouldEnterIdle(uint32_t nowUs) const {
+    return quiet && state == IDLE_SCANNING && (nowUs - lastActivity) >= quiet;
+  }
+
+  // Rows are LOW and edge interrupts armed; columnLow is a read taken after
+  // arming. Returns true if the scanner may stop.
+  bool enterIdle(bool columnLow, uint32_t nowUs) {
+    if (columnLow) {
+      ++stats.missedEdges;
+      lastActivity = nowUs;
+      return false;
+    }
+    state = IDLE_SLEEPING;
+    ++stats.entries;
+    return true;
+  }
+
+  // Column edge interrupt; false for an edge that arrived while not sleeping
+  bool onWakeEdge(uint32_t nowUs) {
+    if (state != IDLE_SLEEPING) return false;
+    state = IDLE_WAKING;
+    wokeAt = nowUs;
+    ++stats.wakes;
+    return true;
+  }
+
+  // Scanning restarted for another reason than a column edge (e.g. after a
+  // benchmark held the matrix)
+  void resume(uint32_t nowUs) {
+    state = IDLE_SCANNING;
+    lastActivity = nowUs;
+  }
+
+  bool sleeping() const { return state == IDLE_SLEEPING; }
+  IdleState getState() const { return state; }
+
+  void resetStats() {
+    stats.entries = 0;
+    stats.wakes = 0;
+    stats.missedEdges = 0;
+    stats.maxWakeUs = 0;
+  }
+
+  const IdleStats &getStats() const { return stats; }
+
+private:
+  uint32_t quiet = 0;
+  uint32_t lastActivity = 0;
+  uint32_t wokeAt = 0;
+  IdleState state = IDLE_SCANNING;
+  IdleStats stats = {};
+};
+
+#endif // IDLEPOLICY_H
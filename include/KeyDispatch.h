@@ -0,0 +1,128 @@
+// KeyDispatch.h
+#ifndef KEYDISPATCH_H
+#define KEYDISPATCH_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+#include "Keymap.h"
+#include "EventQueue.h"
+
+// ================================
+// Scan-side key handling
+//
+// Resolves each committed change to an action through the active layers
+// and queues it for the reporter. The action a key was pressed with is
+// kept until its release, so the release matches even if the layers or
+// the keymap changed in between.
+//
+// If an event is dropped, or release-all runs, the reporter's state is
+// stale: the next scan sends RESET plus a press for every key still held,
+// as soon as the queue has room for all of them.
+// ================================
+
+template <uint16_t QUEUE_SIZE>
+class KeyDispatcher {
+public:
+  typedef SpscQueue<KeyEvent, QUEUE_SIZE> Queue;
+
+  explicit KeyDispatcher(Queue &q) : events(q) {}
+
+  void begin(const ResolvedKeymap &km) {
+    layerState.begin(km);
+    forgetHeld();
+    replayPending = false;
+  }
+
+  // Start of a scan: the events queued until the next call share one
+  // report. Returns true if a pending replay was attempted.
+  bool beginScan() {
+    ++scanSeq;
+    if (!replayPending) return false;
+    replayHeld();
+    return true;
+  }
+
+  void press(uint8_t r, uint8_t c, uint32_t edge) {
+    const PackedAction a = layerState.lookup(r, c);
+    held[r][c] = a;
+    if (a == ACTION_NONE) return;
+
+    if (isLayerAction(a)) {
+      layerState.press(a);
+    } else {
+      layerState.keyPressed();
+    }
+    pushEvent(KEY_EVENT_PRESS, r, c, a, edge);
+  }
+
+  void release(uint8_t r, uint8_t c, uint32_t edge) {
+    const PackedAction a = held[r][c];
+    held[r][c] = ACTION_NONE;
+    if (a == ACTION_NONE) return;
+
+    if (isLayerAction(a)) layerState.release(a);
+    pushEvent(KEY_EVENT_RELEASE, r, c, a, edge);
+  }
+
+  // Forget every held key and go back to the base layer; the replay tells
+  // the reporter to release everything
+  void releaseAll() {
+    forgetHeld();
+    layerState.reset();
+    replayPending = true;
+  }
+
+  LayerState &layers() { return layerState; }
+  const LayerState &layers() const { return layerState; }
+
+  PackedAction heldAction(uint8_t r, uint8_t c) const { return held[r][c]; }
+
+  // Replays sent; read with the scan held off
+  uint32_t replays() const { return replayCount; }
+  void resetReplays() { replayCount = 0; }
+
+private:
+  void forgetHeld() {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) held[r][c] = ACTION_NONE;
+    }
+  }
+
+  void pushEvent(KeyEventType type, uint8_t r, uint8_t c, PackedAction a, uint32_t edge) {
+    if (replayPending) return;  // covered by the replay
+    const KeyEvent ev = {cycleCount(), edge, scanSeq, a, (uint8_t)(r * NUM_COLS + c), (uint8_t)type};
+    if (!events.push(ev)) replayPending = true;
+  }
+
+  // Replaces the reporter's state with the keys held right now
+  void replayHeld() {
+    uint16_t needed = 1;
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        if (held[r][c] != ACTION_NONE && !isLayerAction(held[r][c])) ++needed;
+      }
+    }
+    if (events.freeSlots() < needed) return;  // retry next scan
+
+    const uint32_t now = cycleCount();
+    events.push({now, 0, scanSeq, ACTION_NONE, 0, KEY_EVENT_RESET});
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        const PackedAction a = held[r][c];
+        if (a == ACTION_NONE || isLayerAction(a)) continue;
+        events.push({now, 0, scanSeq, a, (uint8_t)(r * NUM_COLS + c), KEY_EVENT_PRESS});
+      }
+    }
+    replayPending = false;
+    ++replayCount;
+  }
+
+  Queue &events;
+  LayerState layerState;
+  PackedAction held[NUM_ROWS][NUM_COLS] = {};
+  uint16_t scanSeq = 0;
+  bool replayPending = false;
+  uint32_t replayCount = 0;
+};
+
+#endif // KEYDISPATCH_H
@@ -0,0 +1,113 @@
+// KeyLatency.h
+#ifndef KEYLATENCY_H
+#define KEYLATENCY_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+#include "Keymap.h"
+#include "EventQueue.h"
+#include "LatencyHistogram.h"
+
+// Key latency stages, in CPU cycles: first raw edge -> debounce commit ->
+// report handed to USB. Only key events that changed a report count.
+enum LatencyStage : uint8_t {
+  LATENCY_DEBOUNCE,  // raw edge -> commit
+  LATENCY_REPORT,    // commit -> report submitted (queue + reporter)
+  LATENCY_TOTAL,     // raw edge -> report submitted
+  LATENCY_STAGES,
+};
+
+// ================================
+// Raw edge stamps (scan side)
+//
+// Cycle counter at the first read where a key differed from its debounced
+// state, kept through chatter until the change commits. A stamp older
+// than the expiry that never committed is a glitch, not the start of a
+// debounced change, and is dropped.
+// ================================
+
+class EdgeStamps {
+public:
+  // Stamps keys that start to differ from their debounced state
+  void stamp(uint8_t r, uint16_t differs, uint32_t readAt, uint32_t expiryCycles) {
+    uint16_t a = armed[r];
+    if (!(a | differs)) return;
+
+    for (uint16_t check = a; check; check &= (uint16_t)(check - 1)) {
+      const uint8_t c = (uint8_t)__builtin_ctz(check);
+      if ((readAt - cycles[r][c]) > expiryCycles) a &= (uint16_t)~(1u << c);
+    }
+    for (uint16_t fresh = differs & (uint16_t)~a; fresh; fresh &= (uint16_t)(fresh - 1)) {
+      cycles[r][__builtin_ctz(fresh)] = readAt;
+    }
+    armed[r] = a | differs;
+  }
+
+  // The keys in flipped committed; their stamps stay readable until the
+  // next stamp() of the row
+  void commit(uint8_t r, uint16_t flipped) { armed[r] &= (uint16_t)~flipped; }
+
+  uint32_t at(uint8_t r, uint8_t c) const { return cycles[r][c]; }
+
+  void clear(uint8_t r) { armed[r] = 0; }
+
+  void clearAll() {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) armed[r] = 0;
+  }
+
+private:
+  uint32_t cycles[NUM_ROWS][NUM_COLS] = {};
+  uint16_t armed[NUM_ROWS] = {};
+};
+
+// ================================
+// Latency of a report's key events (reporter side)
+//
+// Events are noted as they go into the report being built and recorded
+// once it is handed to USB. Replays (no edge stamp), resets and layer keys
+// are not timed, and events past the batch size go unrecorded (big
+// chords).
+// ================================
+
+class KeyLatency {
+public:
+  static constexpr uint8_t BATCH = 16;
+
+  void note(const KeyEvent &ev) {
+    if (!ev.edge || ev.type == KEY_EVENT_RESET || isLayerAction(ev.action)) return;
+    if (batchLen < BATCH) batch[batchLen++] = {ev.edge, ev.cycles};
+  }
+
+  // The report went out at sent (cycle counter)
+  void sent(uint32_t sentAt) {
+    for (uint8_t i = 0; i < batchLen; ++i) {
+      const Sample &s = batch[i];
+      hist[LATENCY_DEBOUNCE].record(s.commit - s.edge);
+      hist[LATENCY_REPORT].record(sentAt - s.commit);
+      hist[LATENCY_TOTAL].record(sentAt - s.edge);
+    }
+    batchLen = 0;
+  }
+
+  // The report did not change: nothing went out for the noted events
+  void discard() { batchLen = 0; }
+
+  uint8_t pending() const { return batchLen; }
+
+  const LatencyHistogram &stage(LatencyStage s) const { return hist[s]; }
+
+  void reset() {
+    for (uint8_t i = 0; i < LATENCY_STAGES; ++i) hist[i].reset();
+  }
+
+private:
+  struct Sample {
+    uint32_t edge;
+    uint32_t commit;
+  };
+  Sample batch[BATCH] = {};
+  uint8_t batchLen = 0;
+  LatencyHistogram hist[LATENCY_STAGES];
+};
+
+#endif // KEYLATENCY_H
@@ -0,0 +1,78 @@
+// KeyReporter.h
+#ifndef KEYREPORTER_H
+#define KEYREPORTER_H
+
+#include <stdint.h>
+#include "Keymap.h"
+#include "HidReport.h"
+#include "EventQueue.h"
+
+// ================================
+// Key events -> report state
+//
+// Modifier reference counts keep a modifier down while any held chord or
+// modifier key still needs it; the report builder holds the key slots.
+// A chord's modifiers and base key change in the same call, so they always
+// land in the same report.
+// ================================
+
+class KeyReporter {
+public:
+  // Nothing held
+  void reset() {
+    refCtrl = 0;
+    refAlt = 0;
+    refShift = 0;
+    report.clear();
+  }
+
+  void press(PackedAction a) {
+    if (isLayerAction(a)) return;
+    const uint8_t usage = actionUsage(a);
+    const ModMask mods = actionMods(a);
+    if (mods != MOD_NONE) pressModifiers(mods);
+    if (usage) report.pressKey(usage);
+  }
+
+  // Releases the base key, then the modifiers no other held key needs
+  void release(PackedAction a) {
+    if (isLayerAction(a)) return;
+    const uint8_t usage = actionUsage(a);
+    const ModMask mods = actionMods(a);
+    if (usage) report.releaseKey(usage);
+    if (mods != MOD_NONE) releaseModifiers(mods);
+  }
+
+  void apply(const KeyEvent &ev) {
+    switch (ev.type) {
+      case KEY_EVENT_PRESS:   press(ev.action); break;
+      case KEY_EVENT_RELEASE: release(ev.action); break;
+      case KEY_EVENT_RESET:   reset(); break;
+    }
+  }
+
+  // Boot report, if it changed since the last one taken
+  bool takeChanged(KeyboardReport &out) { return report.takeChanged(out); }
+
+  const ReportBuilder &builder() const { return report; }
+
+private:
+  void pressModifiers(ModMask m) {
+    if ((m & MOD_LCTRL) && refCtrl++ == 0) report.setMods(HID_MOD_LCTRL);
+    if ((m & MOD_LALT) && refAlt++ == 0) report.setMods(HID_MOD_LALT);
+    if ((m & MOD_LSHIFT) && refShift++ == 0) report.setMods(HID_MOD_LSHIFT);
+  }
+
+  void releaseModifiers(ModMask m) {
+    if ((m & MOD_LCTRL) && refCtrl > 0 && --refCtrl == 0) report.clearMods(HID_MOD_LCTRL);
+    if ((m & MOD_LALT) && refAlt > 0 && --refAlt == 0) report.clearMods(HID_MOD_LALT);
+    if ((m & MOD_LSHIFT) && refShift > 0 && --refShift == 0) report.clearMods(HID_MOD_LSHIFT);
+  }
+
+  uint16_t refCtrl = 0;
+  uint16_t refAlt = 0;
+  uint16_t refShift = 0;
+  ReportBuilder report;
+};
+
+#endif // KEYREPORTER_H
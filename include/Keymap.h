@@ -0,0 +1,272 @@
+// Keymap.h
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+#include "HidReport.h"
+
+// ================================
+// Key action
+// ================================
+
+// Modifier bitmask
+enum ModMask : uint8_t {
+  MOD_NONE  = 0,
+  MOD_LCTRL = 1 << 0,
+  MOD_LALT  = 1 << 1,
+  MOD_LSHIFT= 1 << 2,
+};
+
+// Keymap layers; layer 0 is the base layer and is always active
+static constexpr uint8_t NUM_LAYERS = 2;
+static constexpr uint8_t LAYER_FN = 1;
+
+// Layer keys
+enum LayerOp : uint8_t {
+  LAYER_OP_NONE = 0,
+  LAYER_OP_MOMENTARY,   // layer active while held
+  LAYER_OP_TOGGLE,      // each press flips the layer
+  LAYER_OP_ONESHOT,     // layer active for the next key press only
+};
+
+// A key action can be:
+// - a base key with optional modifiers (held while pressed)
+// - a pure modifier (e.g., physical Left Shift)
+// - a layer key (momentary, toggle or one-shot)
+//
+// Keys are written as ASCII or KEY_* and translated to raw HID usages at
+// build time (US layout, like the core's default), so the scan path never
+// touches the core's layout tables.
+struct KeyAction {
+  bool valid;           // false: empty position
+  bool modifierOnly;    // true: no base key, only modifiers
+  uint8_t usage;        // HID usage ID of the base key
+  ModMask mods;         // modifiers to hold while pressed (incl. Shift for shifted characters)
+  LayerOp layerOp;      // LAYER_OP_NONE for key and modifier actions
+  uint8_t layer;        // target layer of a layer key
+};
+
+// Key value (ASCII or KEY_*) + modifiers -> usage and final modifiers.
+// An unmappable value gives usage 0, which keymapTranslated() rejects.
+static constexpr KeyAction KA_translate(uint16_t key, ModMask m) {
+  return {true, false, (uint8_t)hidUsageFor(key),
+          (hidUsageFor(key) & HID_USAGE_SHIFT) ? (ModMask)(m | MOD_LSHIFT) : m,
+          LAYER_OP_NONE, 0};
+}
+
+// Helper constructors
+static constexpr KeyAction KA_empty() { return {false, false, 0, MOD_NONE, LAYER_OP_NONE, 0}; }
+static constexpr KeyAction KA_base(char ascii) { return KA_translate((uint16_t)ascii, MOD_NONE); }
+static constexpr KeyAction KA_key(uint16_t keycode) { return KA_translate(keycode, MOD_NONE); }
+static constexpr KeyAction KA_chord(char ascii, ModMask m) { return KA_translate((uint16_t)ascii, m); }
+static constexpr KeyAction KA_chord_key(uint16_t keycode, ModMask m) { return KA_translate(keycode, m); }
+static constexpr KeyAction KA_mod(ModMask m) { return {true, true, 0, m, LAYER_OP_NONE, 0}; }
+static constexpr KeyAction KA_momentary(uint8_t layer) { return {true, false, 0, MOD_NONE, LAYER_OP_MOMENTARY, layer}; }
+static constexpr KeyAction KA_toggle(uint8_t layer) { return {true, false, 0, MOD_NONE, LAYER_OP_TOGGLE, layer}; }
+static constexpr KeyAction KA_oneshot(uint8_t layer) { return {true, false, 0, MOD_NONE, LAYER_OP_ONESHOT, layer}; }
+
+// ================================
+// Packed action (16 bits)
+//
+//   bits 0-7   HID usage (0: modifier-only)
+//   bits 8-10  ModMask
+//   0          empty position (transparent in layers above 0)
+//
+// Layer keys set bit 15:
+//   bits 0-3   target layer
+//   bits 12-13 LayerOp
+// ================================
+
+typedef uint16_t PackedAction;
+
+static constexpr PackedAction ACTION_NONE = 0;
+static constexpr PackedAction ACTION_LAYER = 0x8000;
+
+constexpr PackedAction packAction(const KeyAction &ka) {
+  return !ka.valid ? ACTION_NONE :
+         (ka.layerOp != LAYER_OP_NONE)
+           ? (PackedAction)(ACTION_LAYER | ((uint16_t)ka.layerOp << 12) | (ka.layer & 0x0F))
+           : (PackedAction)(ka.usage | ((uint16_t)ka.mods << 8));
+}
+
+constexpr uint8_t actionUsage(PackedAction a) { return (uint8_t)(a & 0xFF); }
+constexpr ModMask actionMods(PackedAction a) { return (ModMask)((a >> 8) & 0x07); }
+
+constexpr bool isLayerAction(PackedAction a) { return (a & ACTION_LAYER) != 0; }
+constexpr LayerOp actionLayerOp(PackedAction a) { return (LayerOp)((a >> 12) & 0x03); }
+constexpr uint8_t actionLayer(PackedAction a) { return (uint8_t)(a & 0x0F); }
+
+// Packed layers plus, per row, the columns that hold an action on any layer
+struct PackedKeymap {
+  PackedAction actions[NUM_LAYERS][NUM_ROWS][NUM_COLS];
+  uint16_t validRows[NUM_ROWS];
+};
+
+constexpr PackedKeymap packKeymap(const KeyAction (&src)[NUM_LAYERS][NUM_ROWS][NUM_COLS]) {
+  PackedKeymap km{};
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        km.actions[l][r][c] = packAction(src[l][r][c]);
+        if (km.actions[l][r][c] != ACTION_NONE) km.validRows[r] |= (uint16_t)(1u << c);
+      }
+    }
+  }
+  return km;
+}
+
+// Recomputes the valid masks after the actions were edited at runtime
+inline void keymapUpdateValidRows(PackedKeymap &km) {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    uint16_t cols = 0;
+    for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        if (km.actions[l][r][c] != ACTION_NONE) cols |= (uint16_t)(1u << c);
+      }
+    }
+    km.validRows[r] = cols;
+  }
+}
+
+// Every populated key must have resolved to a HID usage, every layer key
+// must target an existing layer, and every action must survive packing
+constexpr bool keymapTranslated(const KeyAction (&src)[NUM_LAYERS][NUM_ROWS][NUM_COLS]) {
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        const KeyAction &ka = src[l][r][c];
+        if (!ka.valid) continue;
+        if (ka.layerOp != LAYER_OP_NONE) {
+          if (ka.layer == 0 || ka.layer >= NUM_LAYERS) return false;
+        } else if (!ka.modifierOnly && ka.usage == 0) {
+          return false;
+        }
+        if (packAction(ka) == ACTION_NONE) return false;
+      }
+    }
+  }
+  return true;
+}
+
+// ================================
+// Resolved keymap
+//
+// One flattened table per combination of layers above 0: every position
+// already holds the action of the highest active layer that defines it, so
+// a lookup is a single indexed read however many layers are stacked, and a
+// layer change only selects another table. Built outside the scan from a
+// PackedKeymap.
+// ================================
+
+static_assert(NUM_LAYERS >= 1 && NUM_LAYERS <= 4, "one flattened table per layer combination");
+static constexpr uint8_t LAYER_COMBOS = 1u << (NUM_LAYERS - 1);
+
+struct ResolvedKeymap {
+  PackedAction flat[LAYER_COMBOS][NUM_ROWS][NUM_COLS];  // [active mask >> 1][row][col]
+  uint16_t validRows[NUM_ROWS];
+  uint16_t validColumns;  // populated in any row (for the all-rows probe)
+};
+
+inline void resolveKeymap(const PackedKeymap &km, ResolvedKeymap &out) {
+  for (uint8_t combo = 0; combo < LAYER_COMBOS; ++combo) {
+    const uint8_t m = (uint8_t)((combo << 1) | 1u);
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        PackedAction a = km.actions[0][r][c];
+        for (uint8_t l = NUM_LAYERS - 1; l > 0; --l) {
+          if ((m & (1u << l)) && km.actions[l][r][c] != ACTION_NONE) {
+            a = km.actions[l][r][c];
+            break;
+          }
+        }
+        out.flat[combo][r][c] = a;
+      }
+    }
+  }
+  out.validColumns = 0;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    out.validRows[r] = km.validRows[r];
+    out.validColumns |= km.validRows[r];
+  }
+}
+
+// ================================
+// Layer state
+//
+// Layer keys change the set of active layers, which selects one of the
+// resolved keymap's flattened tables. Callers keep the action a key was
+// pressed with and release that, so a layer or keymap change while a key
+// is held cannot release a different key.
+// ================================
+
+class LayerState {
+public:
+  void begin(const ResolvedKeymap &km) {
+    keymap = &km;
+    reset();
+  }
+
+  // Back to the base layer only
+  void reset() {
+    for (uint8_t l = 0; l < NUM_LAYERS; ++l) momentary[l] = 0;
+    toggled = 0;
+    oneShot = 0;
+    select();
+  }
+
+  // Switches keymap, keeping the layer state (a pointer swap)
+  void setKeymap(const ResolvedKeymap &km) {
+    keymap = &km;
+    active = keymap->flat[activeMask >> 1];
+  }
+
+  const ResolvedKeymap &resolved() const { return *keymap; }
+
+  PackedAction lookup(uint8_t r, uint8_t c) const { return active[r][c]; }
+
+  // A layer key went down / up
+  void press(PackedAction a) {
+    const uint8_t bit = (uint8_t)(1u << actionLayer(a));
+    switch (actionLayerOp(a)) {
+      case LAYER_OP_MOMENTARY: ++momentary[actionLayer(a)]; break;
+      case LAYER_OP_TOGGLE:    toggled ^= bit; break;
+      case LAYER_OP_ONESHOT:   oneShot |= bit; break;
+      default: return;
+    }
+    select();
+  }
+
+  void release(PackedAction a) {
+    if (actionLayerOp(a) != LAYER_OP_MOMENTARY) return;
+    if (momentary[actionLayer(a)] > 0) --momentary[actionLayer(a)];
+    select();
+  }
+
+  // A non-layer key was pressed through the current table; one-shot
+  // layers have done their job
+  void keyPressed() {
+    if (!oneShot) return;
+    oneShot = 0;
+    select();
+  }
+
+private:
+  void select() {
+    uint8_t m = (uint8_t)(1u | toggled | oneShot);
+    for (uint8_t l = 1; l < NUM_LAYERS; ++l) {
+      if (momentary[l]) m |= (uint8_t)(1u << l);
+    }
+    activeMask = m;
+    active = keymap->flat[m >> 1];
+  }
+
+  const ResolvedKeymap *keymap = nullptr;
+  const PackedAction (*active)[NUM_COLS] = nullptr;
+  uint8_t momentary[NUM_LAYERS] = {};   // held momentary keys per layer
+  uint8_t toggled = 0;
+  uint8_t oneShot = 0;
+  uint8_t activeMask = 1;
+};
+
+#endif // KEYMAP_H
@@ -0,0 +1,113 @@
+// KeymapImage.h
+#ifndef KEYMAPIMAGE_H
+#define KEYMAPIMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Keymap.h"
+#include "Hex.h"
+
+// ================================
+// Binary keymap image
+//
+// Fixed size, little-endian:
+//   0   magic    "EKMP"
+//   4   version  KEYMAP_IMAGE_VERSION
+//   5   layers, rows, cols (must match this build)
+//   8   packed actions [layer][row][col], 16 bits each
+//   ..  CRC-32 (IEEE) of all bytes before it
+//
+// The same image is stored in EEPROM and sent over serial as hex.
+// ================================
+
+static constexpr uint32_t KEYMAP_IMAGE_MAGIC = 0x504D4B45;  // "EKMP"
+static constexpr uint8_t KEYMAP_IMAGE_VERSION = 1;
+static constexpr size_t KEYMAP_IMAGE_HEADER = 8;
+static constexpr size_t KEYMAP_IMAGE_ACTIONS = (size_t)NUM_LAYERS * NUM_ROWS * NUM_COLS;
+static constexpr size_t KEYMAP_IMAGE_SIZE = KEYMAP_IMAGE_HEADER + 2 * KEYMAP_IMAGE_ACTIONS + 4;
+
+enum KeymapImageStatus : uint8_t {
+  KEYMAP_IMAGE_OK = 0,
+  KEYMAP_IMAGE_BAD_SIZE,
+  KEYMAP_IMAGE_BAD_MAGIC,
+  KEYMAP_IMAGE_BAD_VERSION,
+  KEYMAP_IMAGE_BAD_GEOMETRY,
+  KEYMAP_IMAGE_BAD_CRC,
+  KEYMAP_IMAGE_BAD_ACTION,
+};
+
+// Bitwise CRC-32 (reflected 0xEDB88320); images are only checked at boot
+// and on serial writes, so no table
+inline uint32_t crc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (uint8_t b = 0; b < 8; ++b) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+// An action is accepted if this firmware can perform it: no stray bits,
+// and layer keys must target an existing layer above 0
+constexpr bool keymapActionValid(PackedAction a) {
+  return isLayerAction(a)
+    ? ((a & 0x4FF0) == 0 && actionLayerOp(a) != LAYER_OP_NONE &&
+       actionLayer(a) > 0 && actionLayer(a) < NUM_LAYERS)
+    : (a & 0xF800) == 0;
+}
+
+constexpr bool keymapActionsValid(const PackedKeymap &km) {
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        if (!keymapActionValid(km.actions[l][r][c])) return false;
+      }
+    }
+  }
+  return true;
+}
+
+inline void putLE16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+inline void putLE32(uint8_t *p, uint32_t v) { putLE16(p, (uint16_t)v); putLE16(p + 2, (uint16_t)(v >> 16)); }
+inline uint16_t getLE16(const uint8_t *p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+inline uint32_t getLE32(const uint8_t *p) { return getLE16(p) | ((uint32_t)getLE16(p + 2) << 16); }
+
+inline void serializeKeymap(const PackedKeymap &km, uint8_t (&out)[KEYMAP_IMAGE_SIZE]) {
+  putLE32(out, KEYMAP_IMAGE_MAGIC);
+  out[4] = KEYMAP_IMAGE_VERSION;
+  out[5] = NUM_LAYERS;
+  out[6] = NUM_ROWS;
+  out[7] = NUM_COLS;
+  uint8_t *p = out + KEYMAP_IMAGE_HEADER;
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c, p += 2) putLE16(p, km.actions[l][r][c]);
+    }
+  }
+  putLE32(p, crc32(out, KEYMAP_IMAGE_SIZE - 4));
+}
+
+// Fills out (actions and valid masks) only if the whole image checks out
+inline KeymapImageStatus parseKeymap(const uint8_t *in, size_t len, PackedKeymap &out) {
+  if (len != KEYMAP_IMAGE_SIZE) return KEYMAP_IMAGE_BAD_SIZE;
+  if (getLE32(in) != KEYMAP_IMAGE_MAGIC) return KEYMAP_IMAGE_BAD_MAGIC;
+  if (in[4] != KEYMAP_IMAGE_VERSION) return KEYMAP_IMAGE_BAD_VERSION;
+  if (in[5] != NUM_LAYERS || in[6] != NUM_ROWS || in[7] != NUM_COLS) return KEYMAP_IMAGE_BAD_GEOMETRY;
+  if (getLE32(in + KEYMAP_IMAGE_SIZE - 4) != crc32(in, KEYMAP_IMAGE_SIZE - 4)) return KEYMAP_IMAGE_BAD_CRC;
+
+  const uint8_t *actions = in + KEYMAP_IMAGE_HEADER;
+  for (size_t i = 0; i < KEYMAP_IMAGE_ACTIONS; ++i) {
+    if (!keymapActionValid(getLE16(actions + 2 * i))) return KEYMAP_IMAGE_BAD_ACTION;
+  }
+
+  const uint8_t *p = actions;
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c, p += 2) out.actions[l][r][c] = getLE16(p);
+    }
+  }
+  keymapUpdateValidRows(out);
+  return KEYMAP_IMAGE_OK;
+}
+
+#endif // KEYMAPIMAGE_H
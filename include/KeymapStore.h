@@ -0,0 +1,17 @@
+// KeymapStore.h
+#ifndef KEYMAPSTORE_H
+#define KEYMAPSTORE_H
+
+#include "Keymap.h"
+#include "KeymapImage.h"
+
+// Reads the stored image into km; km is left untouched unless KEYMAP_IMAGE_OK
+KeymapImageStatus keymapStoreLoad(PackedKeymap &km);
+
+// Writes km as an image (only bytes that differ are rewritten)
+void keymapStoreSave(const PackedKeymap &km);
+
+// Invalidates the stored image so the next boot uses the compiled-in keymap
+void keymapStoreErase();
+
+#endif // KEYMAPSTORE_H
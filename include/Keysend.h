@@ -4,14 +4,129 @@
 
 #include <Arduino.h>
 #include <Keyboard.h>
+#include "ScanScheduler.h"
+#include "IdlePolicy.h"
+#include "MatrixIO.h"
+#include "EventQueue.h"
+#include "SofAligner.h"
+#include "UsbDescriptor.h"
+#include "Keymap.h"
+#include "KeyLatency.h"
+#include "PerfProfile.h"
+#include "Bench.h"
 
-// Initializes USB keyboard and matrix GPIOs
+// Initializes USB keyboard and matrix GPIOs, then starts the scan timer
 void keyboardInit();
 
-// Runs one scan cycle, debounces, and sends key events
+// Runs one scan cycle, debounces, and queues key events (called from the scan timer)
 void keyboardScan();
 
-// Optionally release all keys and modifiers (panic/cleanup)
+// Drains queued key events into HID reports, one per scan; call from loop()
+void keyboardReport();
+
+// Stops scanning, runs a scan microbenchmark on a synthetic matrix with
+// the live keymap and settle times, then resumes; call from loop()
+bool keyboardBench(BenchScenario scenario, uint32_t iterations, BenchResult &out);
+
+// Optionally release all keys and modifiers (panic/cleanup); call from loop()
 void keyboardReleaseAll();
 
+// Sleeps (WFI) while the matrix is idle and waiting for a column edge; call from loop()
+void keyboardIdle();
+
+// Latency histograms, owned by the reporter (call from loop())
+const LatencyHistogram &keyboardLatency(LatencyStage stage);
+void keyboardLatencyReset();
+
+#if PERF_PROFILE
+// Records a loop-side stage (PERF_REPORT, PERF_SERIAL); call from loop()
+void keyboardPerfRecord(PerfStage stage, uint32_t cycles);
+
+// Copies the stage profiler counters and the cycles in one scan period,
+// optionally resetting the counters
+void keyboardPerfStats(PerfStats (&out)[PERF_STAGES], uint32_t &scanBudgetCycles, bool reset);
+#endif
+
+// Copies the scan period/jitter counters, optionally resetting them
+void keyboardScanStats(ScanStats &out, bool reset);
+
+// Per-row settle times in CPU cycles as set at boot, the default a row
+// falls back to and the measured column recovery floor (0 with
+// SETTLE_FIXED); returns the rows (bit r) that use the default
+uint16_t keyboardSettleTimes(uint32_t (&cycles)[NUM_ROWS], uint32_t &defaultCycles, uint32_t &floorCycles);
+
+// Copies the scan -> reporter queue counters and the number of resync
+// replays (after a drop or release-all), optionally resetting them
+void keyboardQueueStats(QueueStats &out, uint32_t &replays, bool reset);
+
+// Keyboard endpoint as declared to the host
+struct KeyboardUsbInfo {
+  bool highSpeed;            // link speed right now
+  HidEndpointInfo endpoint;  // from the configuration descriptor for that speed
+  uint32_t pollUs;           // endpoint polling period
+  uint32_t scanRateHz;
+};
+
+// Parses the core's configuration descriptor; false if no boot keyboard
+// endpoint was found
+bool keyboardUsbInfo(KeyboardUsbInfo &out);
+
+#ifdef SOF_ALIGN
+// Copies the SOF alignment counters and the last phase error, optionally
+// resetting the counters
+void keyboardSofStats(SofStats &out, int32_t &phaseErrorUs, bool reset);
+#endif
+
+// Copies the idle entry/wake counters, optionally resetting them
+void keyboardIdleStats(IdleStats &out, bool reset);
+
+// ================================
+// Keymap profiles
+//
+// Named keymaps held in RAM. Profile 0 ("main") is the boot keymap, loaded
+// from EEPROM or the compiled-in default. A switch or edit takes effect at
+// the start of the next scan.
+// ================================
+
+static const uint8_t KEYMAP_PROFILES = 4;
+static const uint8_t PROFILE_NAME_LEN = 15;
+
+// Where a profile's keymap came from
+enum KeymapSource : uint8_t {
+  KEYMAP_SOURCE_DEFAULT,  // compiled-in keymap
+  KEYMAP_SOURCE_STORED,   // EEPROM image (matches EEPROM)
+  KEYMAP_SOURCE_EDITED,   // edited or loaded since, RAM only
+};
+
+// Copies the active profile's keymap
+void keyboardKeymapGet(PackedKeymap &out);
+KeymapSource keyboardKeymapSource();
+
+// Saves a parsed image to EEPROM as the boot keymap (profile 0)
+void keyboardKeymapWrite(const PackedKeymap &km);
+
+// Changes one position of the active profile in RAM; false if out of range
+// or not a valid action
+bool keyboardKeymapSet(uint8_t layer, uint8_t row, uint8_t col, PackedAction action);
+
+// Saves the active profile to EEPROM as the boot keymap
+void keyboardKeymapSave();
+
+// Erases the stored image; profile 0 goes back to the compiled-in keymap
+void keyboardKeymapReset();
+
+// Makes a profile active; false for an empty slot
+bool keyboardProfileSelect(uint8_t slot);
+
+// Slot of the named profile, -1 if none
+int8_t keyboardProfileFind(const char *name);
+
+// Loads km into slot 1..KEYMAP_PROFILES-1 under name
+bool keyboardProfileStore(uint8_t slot, const char *name, const PackedKeymap &km);
+
+uint8_t keyboardProfileActive();
+
+// Name of a slot, nullptr if empty
+const char *keyboardProfileName(uint8_t slot);
+
 #endif
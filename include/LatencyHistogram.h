@@ -0,0 +1,75 @@
+// LatencyHistogram.h
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+
+// ================================
+// Log-bucketed latency histogram
+//
+// Samples are cycle counts. Values below 4 get a bucket each; above that
+// every power of two is split into four buckets, so a bucket is at most a
+// quarter of its lower bound wide and 124 buckets cover all 32-bit values.
+// Recording is a count-leading-zeros and an increment. A percentile comes
+// back as the top of the bucket it falls in, capped at the exact maximum,
+// so it is never understated.
+// ================================
+
+class LatencyHistogram {
+public:
+  static constexpr uint8_t BUCKETS = 124;
+
+  static uint8_t bucketOf(uint32_t v) {
+    if (v < 4) return (uint8_t)v;
+    const uint8_t msb = (uint8_t)(31 - __builtin_clz(v));
+    return (uint8_t)(((msb - 1) << 2) | ((v >> (msb - 2)) & 3));
+  }
+
+  // Largest value that lands in bucket b
+  static uint32_t bucketMax(uint8_t b) {
+    if (b < 4) return b;
+    const uint8_t shift = (uint8_t)((b >> 2) - 1);
+    const uint32_t lower = (uint32_t)(4 + (b & 3)) << shift;
+    return lower + ((1u << shift) - 1);
+  }
+
+  void record(uint32_t v) {
+    ++counts[bucketOf(v)];
+    ++n;
+    if (v > maxValue) maxValue = v;
+  }
+
+  void reset() {
+    for (uint8_t b = 0; b < BUCKETS; ++b) counts[b] = 0;
+    n = 0;
+    maxValue = 0;
+  }
+
+  uint32_t count() const { return n; }
+  uint32_t max() const { return maxValue; }
+  uint32_t bucketCount(uint8_t b) const { return b < BUCKETS ? counts[b] : 0; }
+
+  // Smallest bucket top with at least pct% of the samples at or below it
+  // (0 with no samples)
+  uint32_t percentile(uint8_t pct) const {
+    if (!n) return 0;
+    uint32_t rank = (uint32_t)(((uint64_t)n * pct + 99) / 100);
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < BUCKETS; ++b) {
+      seen += counts[b];
+      if (seen >= rank) {
+        const uint32_t top = bucketMax(b);
+        return top < maxValue ? top : maxValue;
+      }
+    }
+    return maxValue;
+  }
+
+private:
+  uint32_t counts[BUCKETS] = {};
+  uint32_t n = 0;
+  uint32_t maxValue = 0;
+};
+
+#endif // LATENCYHISTOGRAM_H
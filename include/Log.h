@@ -0,0 +1,126 @@
+// Log.h
+#ifndef LOG_H
+#define LOG_H
+
+// ================================
+// Compile-time logging
+//
+// Each subsystem has its own level, fixed at build time:
+//
+//   LOG_SCAN_*      matrix, scan timer, settle calibration, SOF alignment
+//   LOG_DEBOUNCE_*  debounce engine
+//   LOG_HID_*       keymap, layers, reports (LOG_HID_TRACE: binary trace)
+//   LOG_SERIAL_*    boot and serial command handling
+//
+// A call at or below the subsystem's level goes to debugPrintf() (which
+// still honours debugMode). Any other call sits inside an unevaluated
+// sizeof: it is type-checked, but no code, no argument evaluation and no
+// format string make it into the binary, at any optimization level.
+//
+// Levels default to LOG_LEVEL_DEBUG with -D DEBUG and LOG_LEVEL_NONE
+// without; override one with e.g. -D LOG_LEVEL_HID=LOG_LEVEL_ERROR.
+// ================================
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_DEBUG 3
+
+#ifndef LOG_LEVEL_DEFAULT
+#ifdef DEBUG
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_NONE
+#endif
+#endif
+
+#ifndef LOG_LEVEL_SCAN
+#define LOG_LEVEL_SCAN LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_DEBOUNCE
+#define LOG_LEVEL_DEBOUNCE LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_HID
+#define LOG_LEVEL_HID LOG_LEVEL_DEFAULT
+#endif
+#ifndef LOG_LEVEL_SERIAL
+#define LOG_LEVEL_SERIAL LOG_LEVEL_DEFAULT
+#endif
+
+// Backends
+#define LOG_EMIT(...)       debugPrintf(__VA_ARGS__)
+#define LOG_DISCARD(...)    ((void)sizeof((debugPrintf(__VA_ARGS__), 0)))
+#define TRACE_EMIT(...)     trace(__VA_ARGS__)
+#define TRACE_DISCARD(...)  ((void)sizeof((trace(__VA_ARGS__), 0)))
+
+// ---- scan ----
+#if LOG_LEVEL_SCAN >= LOG_LEVEL_ERROR
+#define LOG_SCAN_ERROR LOG_EMIT
+#else
+#define LOG_SCAN_ERROR LOG_DISCARD
+#endif
+#if LOG_LEVEL_SCAN >= LOG_LEVEL_INFO
+#define LOG_SCAN_INFO LOG_EMIT
+#else
+#define LOG_SCAN_INFO LOG_DISCARD
+#endif
+#if LOG_LEVEL_SCAN >= LOG_LEVEL_DEBUG
+#define LOG_SCAN_DEBUG LOG_EMIT
+#else
+#define LOG_SCAN_DEBUG LOG_DISCARD
+#endif
+
+// ---- debounce ----
+#if LOG_LEVEL_DEBOUNCE >= LOG_LEVEL_ERROR
+#define LOG_DEBOUNCE_ERROR LOG_EMIT
+#else
+#define LOG_DEBOUNCE_ERROR LOG_DISCARD
+#endif
+#if LOG_LEVEL_DEBOUNCE >= LOG_LEVEL_INFO
+#define LOG_DEBOUNCE_INFO LOG_EMIT
+#else
+#define LOG_DEBOUNCE_INFO LOG_DISCARD
+#endif
+#if LOG_LEVEL_DEBOUNCE >= LOG_LEVEL_DEBUG
+#define LOG_DEBOUNCE_DEBUG LOG_EMIT
+#else
+#define LOG_DEBOUNCE_DEBUG LOG_DISCARD
+#endif
+
+// ---- hid ----
+#if LOG_LEVEL_HID >= LOG_LEVEL_ERROR
+#define LOG_HID_ERROR LOG_EMIT
+#else
+#define LOG_HID_ERROR LOG_DISCARD
+#endif
+#if LOG_LEVEL_HID >= LOG_LEVEL_INFO
+#define LOG_HID_INFO LOG_EMIT
+#else
+#define LOG_HID_INFO LOG_DISCARD
+#endif
+#if LOG_LEVEL_HID >= LOG_LEVEL_DEBUG
+#define LOG_HID_DEBUG LOG_EMIT
+#define LOG_HID_TRACE TRACE_EMIT
+#else
+#define LOG_HID_DEBUG LOG_DISCARD
+#define LOG_HID_TRACE TRACE_DISCARD
+#endif
+
+// ---- serial ----
+#if LOG_LEVEL_SERIAL >= LOG_LEVEL_ERROR
+#define LOG_SERIAL_ERROR LOG_EMIT
+#else
+#define LOG_SERIAL_ERROR LOG_DISCARD
+#endif
+#if LOG_LEVEL_SERIAL >= LOG_LEVEL_INFO
+#define LOG_SERIAL_INFO LOG_EMIT
+#else
+#define LOG_SERIAL_INFO LOG_DISCARD
+#endif
+#if LOG_LEVEL_SERIAL >= LOG_LEVEL_DEBUG
+#define LOG_SERIAL_DEBUG LOG_EMIT
+#else
+#define LOG_SERIAL_DEBUG LOG_DISCARD
+#endif
+
+#endif // LOG_H
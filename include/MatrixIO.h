@@ -0,0 +1,429 @@
+// MatrixIO.h
+#ifndef MATRIXIO_H
+#define MATRIXIO_H
+
+#include <stdint.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+// Matrix
+static constexpr uint8_t NUM_ROWS = 10;
+static constexpr uint8_t NUM_COLS = 14;
+
+// Packed column word: bit c set => column c reads pressed (LOW)
+static constexpr uint16_t COL_MASK = (uint16_t)((1u << NUM_COLS) - 1);
+
+// ================================
+// Matrix pin mapping (Teensy 4.0)
+//
+// COL2ROW diodes: diodes from Column (anode) to Row (cathode).
+// Scanning: drive one ROW LOW at a time, and read COLUMNS with pull-ups.
+// Pressed key => corresponding column reads LOW when its row is selected.
+// ================================
+
+static constexpr uint8_t colPins[NUM_COLS] = {
+  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 14
+};
+
+static constexpr uint8_t rowPins[NUM_ROWS] = {
+  15, 16, 17, 18, 19, 20, 21, 22, 23, 24
+};
+
+// ================================
+// Teensy 4.0 pin -> fast GPIO port/bit
+//
+// Mirrors CORE_PINn_PORTREG / CORE_PINn_BIT from the core's core_pins.h
+// for pins 0..24 (checked against the core below when building for target).
+// ================================
+
+enum GpioPort : uint8_t {
+  PORT_GPIO6 = 0,
+  PORT_GPIO7,
+  PORT_GPIO8,
+  PORT_GPIO9,
+  NUM_PORTS
+};
+
+struct PinLoc {
+  uint8_t port;
+  uint8_t bit;
+};
+
+static constexpr uint8_t NUM_MAPPED_PINS = 25;
+
+static constexpr PinLoc pinLoc[NUM_MAPPED_PINS] = {
+  {PORT_GPIO6,  3}, {PORT_GPIO6,  2}, {PORT_GPIO9,  4}, {PORT_GPIO9,  5}, // 0-3
+  {PORT_GPIO9,  6}, {PORT_GPIO9,  8}, {PORT_GPIO7, 10}, {PORT_GPIO7, 17}, // 4-7
+  {PORT_GPIO7, 16}, {PORT_GPIO7, 11}, {PORT_GPIO7,  0}, {PORT_GPIO7,  2}, // 8-11
+  {PORT_GPIO7,  1}, {PORT_GPIO7,  3}, {PORT_GPIO6, 18}, {PORT_GPIO6, 19}, // 12-15
+  {PORT_GPIO6, 23}, {PORT_GPIO6, 22}, {PORT_GPIO6, 17}, {PORT_GPIO6, 16}, // 16-19
+  {PORT_GPIO6, 26}, {PORT_GPIO6, 27}, {PORT_GPIO6, 24}, {PORT_GPIO6, 25}, // 20-23
+  {PORT_GPIO6, 12},                                                       // 24
+};
+
+#ifdef CORE_PIN0_BIT
+static_assert(pinLoc[0].bit == CORE_PIN0_BIT && pinLoc[1].bit == CORE_PIN1_BIT &&
+              pinLoc[2].bit == CORE_PIN2_BIT && pinLoc[3].bit == CORE_PIN3_BIT &&
+              pinLoc[4].bit == CORE_PIN4_BIT && pinLoc[5].bit == CORE_PIN5_BIT &&
+              pinLoc[6].bit == CORE_PIN6_BIT && pinLoc[7].bit == CORE_PIN7_BIT &&
+              pinLoc[8].bit == CORE_PIN8_BIT && pinLoc[9].bit == CORE_PIN9_BIT &&
+              pinLoc[10].bit == CORE_PIN10_BIT && pinLoc[11].bit == CORE_PIN11_BIT &&
+              pinLoc[12].bit == CORE_PIN12_BIT && pinLoc[13].bit == CORE_PIN13_BIT &&
+              pinLoc[14].bit == CORE_PIN14_BIT && pinLoc[15].bit == CORE_PIN15_BIT &&
+              pinLoc[16].bit == CORE_PIN16_BIT && pinLoc[17].bit == CORE_PIN17_BIT &&
+              pinLoc[18].bit == CORE_PIN18_BIT && pinLoc[19].bit == CORE_PIN19_BIT &&
+              pinLoc[20].bit == CORE_PIN20_BIT && pinLoc[21].bit == CORE_PIN21_BIT &&
+              pinLoc[22].bit == CORE_PIN22_BIT && pinLoc[23].bit == CORE_PIN23_BIT &&
+              pinLoc[24].bit == CORE_PIN24_BIT,
+              "pinLoc[] does not match core_pins.h");
+
+// CORE_PINn_PORTREG is its port's DR register. Register addresses are not
+// constant expressions, so the port is checked on the macro's expansion
+// text, which ends in the GPIO block's base address.
+#define MATRIX_REG_TEXT_(reg) #reg
+#define MATRIX_REG_TEXT(reg) MATRIX_REG_TEXT_(reg)
+
+static constexpr const char *gpioBaseText[NUM_PORTS] = {
+  "0x42000000", "0x42004000", "0x42008000", "0x4200C000"
+};
+
+constexpr char upperHex(char ch) { return (ch >= 'a' && ch <= 'f') ? (char)(ch - 'a' + 'A') : ch; }
+
+constexpr bool textAt(const char *s, const char *sub) {
+  return !*sub || (*s && upperHex(*s) == upperHex(*sub) && textAt(s + 1, sub + 1));
+}
+
+constexpr bool textContains(const char *s, const char *sub) {
+  return textAt(s, sub) || (*s && textContains(s + 1, sub));
+}
+
+#define MATRIX_PIN_PORT_OK(n) textContains(MATRIX_REG_TEXT(CORE_PIN##n##_PORTREG), gpioBaseText[pinLoc[n].port])
+
+static_assert(MATRIX_PIN_PORT_OK(0) && MATRIX_PIN_PORT_OK(1) && MATRIX_PIN_PORT_OK(2) &&
+              MATRIX_PIN_PORT_OK(3) && MATRIX_PIN_PORT_OK(4) && MATRIX_PIN_PORT_OK(5) &&
+              MATRIX_PIN_PORT_OK(6) && MATRIX_PIN_PORT_OK(7) && MATRIX_PIN_PORT_OK(8) &&
+              MATRIX_PIN_PORT_OK(9) && MATRIX_PIN_PORT_OK(10) && MATRIX_PIN_PORT_OK(11) &&
+              MATRIX_PIN_PORT_OK(12) && MATRIX_PIN_PORT_OK(13) && MATRIX_PIN_PORT_OK(14) &&
+              MATRIX_PIN_PORT_OK(15) && MATRIX_PIN_PORT_OK(16) && MATRIX_PIN_PORT_OK(17) &&
+              MATRIX_PIN_PORT_OK(18) && MATRIX_PIN_PORT_OK(19) && MATRIX_PIN_PORT_OK(20) &&
+              MATRIX_PIN_PORT_OK(21) && MATRIX_PIN_PORT_OK(22) && MATRIX_PIN_PORT_OK(23) &&
+              MATRIX_PIN_PORT_OK(24),
+              "pinLoc[] ports do not match core_pins.h");
+#endif
+
+// ================================
+// Column gather table
+//
+// Columns whose port bit sits at the same distance from their column index
+// share one step: (PSR & mask) shifted by that distance. The table is built
+// at compile time from colPins[], so a column word costs one PSR read per
+// port in use plus a shift/and/or per step.
+// ================================
+
+struct GatherStep {
+  uint8_t port;
+  int8_t shift;   // >0: shift right, <0: shift left
+  uint32_t mask;  // source bits on the port register
+};
+
+struct ColumnGather {
+  GatherStep steps[NUM_COLS];
+  uint8_t count;
+  uint8_t portMask; // bit p set => port p holds at least one column
+};
+
+constexpr ColumnGather buildColumnGather() {
+  ColumnGather g{};
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    const PinLoc loc = pinLoc[colPins[c]];
+    const int8_t shift = (int8_t)((int)loc.bit - (int)c);
+    uint8_t i = 0;
+    while (i < g.count && !(g.steps[i].port == loc.port && g.steps[i].shift == shift)) ++i;
+    if (i == g.count) {
+      g.steps[i].port = loc.port;
+      g.steps[i].shift = shift;
+      g.steps[i].mask = 0;
+      ++g.count;
+    }
+    g.steps[i].mask |= (1u << loc.bit);
+    g.portMask |= (uint8_t)(1u << loc.port);
+  }
+  return g;
+}
+
+static constexpr ColumnGather colGather = buildColumnGather();
+
+constexpr bool colPinsMapped() {
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    if (colPins[c] >= NUM_MAPPED_PINS) return false;
+  }
+  return true;
+}
+static_assert(colPinsMapped(), "colPins[] uses a pin without a pinLoc[] entry");
+
+constexpr bool rowPinsMapped() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    if (rowPins[r] >= NUM_MAPPED_PINS) return false;
+  }
+  return true;
+}
+static_assert(rowPinsMapped(), "rowPins[] uses a pin without a pinLoc[] entry");
+
+// Every bit of the gathered word must come from exactly one column
+constexpr bool colGatherCovers() {
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < colGather.count; ++i) {
+    const GatherStep &s = colGather.steps[i];
+    const uint32_t out = (s.shift >= 0) ? (s.mask >> s.shift) : (s.mask << -s.shift);
+    if (seen & out) return false;
+    seen |= out;
+  }
+  return seen == COL_MASK;
+}
+static_assert(colGatherCovers(), "column gather table does not cover colPins[]");
+
+// ================================
+// Row drive table
+//
+// Rows are open-drain outputs configured once at init. Clearing a row's
+// output bit drives it LOW (selected); setting it releases the line (Hi-Z),
+// so a select or release is a single DR_CLEAR/DR_SET write.
+// ================================
+
+struct RowDrive {
+  uint8_t port;
+  uint32_t mask;
+};
+
+struct RowDriveTable {
+  RowDrive rows[NUM_ROWS];
+  uint32_t portMask[NUM_PORTS]; // all row bits per port, for releasing every row
+};
+
+constexpr RowDriveTable buildRowDrive() {
+  RowDriveTable t{};
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    const PinLoc loc = pinLoc[rowPins[r]];
+    t.rows[r].port = loc.port;
+    t.rows[r].mask = 1u << loc.bit;
+    t.portMask[loc.port] |= 1u << loc.bit;
+  }
+  return t;
+}
+
+static constexpr RowDriveTable rowDrive = buildRowDrive();
+
+// Column bits per port, for driving every column LOW at once when
+// measuring how fast the pull-ups recover (boot calibration only)
+struct ColumnDrive {
+  uint32_t portMask[NUM_PORTS];
+};
+
+constexpr ColumnDrive buildColumnDrive() {
+  ColumnDrive d{};
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    const PinLoc loc = pinLoc[colPins[c]];
+    d.portMask[loc.port] |= 1u << loc.bit;
+  }
+  return d;
+}
+
+static constexpr ColumnDrive colDrive = buildColumnDrive();
+
+// ================================
+// Port register access
+// ================================
+
+#ifdef ARDUINO
+
+static inline uint32_t readPortPSR(uint8_t port) {
+  switch (port) {
+    case PORT_GPIO6: return GPIO6_PSR;
+    case PORT_GPIO7: return GPIO7_PSR;
+    case PORT_GPIO8: return GPIO8_PSR;
+    default:         return GPIO9_PSR;
+  }
+}
+
+static inline void writePortSet(uint8_t port, uint32_t mask) {
+  switch (port) {
+    case PORT_GPIO6: GPIO6_DR_SET = mask; break;
+    case PORT_GPIO7: GPIO7_DR_SET = mask; break;
+    case PORT_GPIO8: GPIO8_DR_SET = mask; break;
+    default:         GPIO9_DR_SET = mask; break;
+  }
+}
+
+static inline void writePortClear(uint8_t port, uint32_t mask) {
+  switch (port) {
+    case PORT_GPIO6: GPIO6_DR_CLEAR = mask; break;
+    case PORT_GPIO7: GPIO7_DR_CLEAR = mask; break;
+    case PORT_GPIO8: GPIO8_DR_CLEAR = mask; break;
+    default:         GPIO9_DR_CLEAR = mask; break;
+  }
+}
+
+// Direction bits have no set/clear alias; read-modify-write
+static inline void writePortDirection(uint8_t port, uint32_t mask, bool output) {
+  switch (port) {
+    case PORT_GPIO6: GPIO6_GDIR = output ? (GPIO6_GDIR | mask) : (GPIO6_GDIR & ~mask); break;
+    case PORT_GPIO7: GPIO7_GDIR = output ? (GPIO7_GDIR | mask) : (GPIO7_GDIR & ~mask); break;
+    case PORT_GPIO8: GPIO8_GDIR = output ? (GPIO8_GDIR | mask) : (GPIO8_GDIR & ~mask); break;
+    default:         GPIO9_GDIR = output ? (GPIO9_GDIR | mask) : (GPIO9_GDIR & ~mask); break;
+  }
+}
+
+// DWT cycle counter (enabled by the Teensy 4 startup code)
+static inline uint32_t cycleCount() {
+  return ARM_DWT_CYCCNT;
+}
+
+static inline uint32_t cyclesPerUs() {
+  return F_CPU_ACTUAL / 1000000;
+}
+
+#else
+
+// Host build: port registers are simulated so the gather logic can run
+// without a Teensy. Tests set psr[] and read back dr[] and the access counts;
+// the cycle counter advances one cycle per read plus whatever a test adds.
+// A test can also install a model, called after every DR write and before
+// every PSR read, that derives psr[] from dr[] and the cycle count (e.g. an
+// RC settling model of the matrix).
+struct SimGpio {
+  uint32_t psr[NUM_PORTS];
+  uint32_t dr[NUM_PORTS];
+  uint32_t gdir[NUM_PORTS];
+  uint32_t psrReads;
+  uint32_t drWrites;
+  uint32_t cycles;
+  void (*model)(SimGpio &sim);
+};
+
+inline SimGpio &simGpio() {
+  static SimGpio sim;
+  return sim;
+}
+
+static inline uint32_t readPortPSR(uint8_t port) {
+  SimGpio &sim = simGpio();
+  ++sim.psrReads;
+  if (sim.model) sim.model(sim);
+  return sim.psr[port];
+}
+
+static inline void writePortSet(uint8_t port, uint32_t mask) {
+  SimGpio &sim = simGpio();
+  ++sim.drWrites;
+  sim.dr[port] |= mask;
+  if (sim.model) sim.model(sim);
+}
+
+static inline void writePortClear(uint8_t port, uint32_t mask) {
+  SimGpio &sim = simGpio();
+  ++sim.drWrites;
+  sim.dr[port] &= ~mask;
+  if (sim.model) sim.model(sim);
+}
+
+static inline void writePortDirection(uint8_t port, uint32_t mask, bool output) {
+  SimGpio &sim = simGpio();
+  sim.gdir[port] = output ? (sim.gdir[port] | mask) : (sim.gdir[port] & ~mask);
+  if (sim.model) sim.model(sim);
+}
+
+static inline uint32_t cycleCount() {
+  return ++simGpio().cycles;
+}
+
+static inline uint32_t cyclesPerUs() {
+  return 600; // Teensy 4.0 default clock
+}
+
+#endif
+
+// Busy-waits until the given settle time has passed since a row select
+static inline void waitSettle(uint32_t selectedAt, uint32_t cycles) {
+  while ((cycleCount() - selectedAt) < cycles) {
+  }
+}
+
+// Unrolled at compile time: each step becomes a shift/and/or on a constant
+template <uint8_t I>
+struct GatherSteps {
+  static inline uint32_t apply(const uint32_t *psr) {
+    constexpr GatherStep s = colGather.steps[I];
+    const uint32_t v = psr[s.port] & s.mask;
+    return ((s.shift >= 0) ? (v >> (s.shift & 31)) : (v << (-s.shift & 31))) |
+           GatherSteps<I + 1>::apply(psr);
+  }
+};
+
+template <>
+struct GatherSteps<colGather.count> {
+  static inline uint32_t apply(const uint32_t *) { return 0; }
+};
+
+// Packs raw port values into a column word (bit c = column c reads HIGH)
+static inline uint16_t gatherColumns(const uint32_t psr[NUM_PORTS]) {
+  return (uint16_t)GatherSteps<0>::apply(psr);
+}
+
+// Reads every port holding a column once; returns pressed (LOW) columns
+static inline uint16_t readColumns() {
+  uint32_t psr[NUM_PORTS] = {0, 0, 0, 0};
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (colGather.portMask & (1u << p)) psr[p] = readPortPSR(p);
+  }
+  return (uint16_t)(~gatherColumns(psr) & COL_MASK);
+}
+
+// Drives one row LOW
+static inline void selectRow(uint8_t row) {
+  writePortClear(rowDrive.rows[row].port, rowDrive.rows[row].mask);
+}
+
+// Releases one row (Hi-Z)
+static inline void releaseRow(uint8_t row) {
+  writePortSet(rowDrive.rows[row].port, rowDrive.rows[row].mask);
+}
+
+// Reads back a row line: true once it has actually fallen LOW
+static inline bool rowReadsLow(uint8_t row) {
+  return (readPortPSR(rowDrive.rows[row].port) & rowDrive.rows[row].mask) == 0;
+}
+
+// Drives every row LOW at once (any-key probe), one write per port holding rows
+static inline void selectAllRows() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (rowDrive.portMask[p]) writePortClear(p, rowDrive.portMask[p]);
+  }
+}
+
+// Releases every row, one write per port holding rows
+static inline void releaseAllRows() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (rowDrive.portMask[p]) writePortSet(p, rowDrive.portMask[p]);
+  }
+}
+
+// Drives every column LOW as an output (columns are otherwise pulled-up
+// inputs; the core's INPUT_PULLUP pad setting keeps the output drive
+// enabled); boot calibration only, never while scanning
+static inline void driveColumnsLow() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (!colDrive.portMask[p]) continue;
+    writePortClear(p, colDrive.portMask[p]);
+    writePortDirection(p, colDrive.portMask[p], true);
+  }
+}
+
+// Returns the columns to inputs, left to rise through their pull-ups
+static inline void releaseColumns() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (colDrive.portMask[p]) writePortDirection(p, colDrive.portMask[p], false);
+  }
+}
+
+#endif // MATRIXIO_H
@@ -0,0 +1,93 @@
+// PerfProfile.h
+#ifndef PERFPROFILE_H
+#define PERFPROFILE_H
+
+#include <stdint.h>
+
+// ================================
+// Stage cycle profiler
+//
+// Compiled in by default; -D PERF_PROFILE=0 removes the counters and every
+// lap from the scan. Times are CPU cycles.
+//
+// The scan runs as a chain of laps: each lap() charges the cycles since the
+// previous one to a stage, and end() records every stage that ran in that
+// scan plus the whole scan, so scan stages are per-scan sums. The report
+// stage is recorded per call that had events, the serial stage on every
+// call (the idle polls are most of its cost), and each serial command on
+// its own so a slow one does not hide in the polling numbers.
+// ================================
+
+#ifndef PERF_PROFILE
+#define PERF_PROFILE 1
+#endif
+
+enum PerfStage : uint8_t {
+  PERF_SELECT,    // row select/release and settle waits
+  PERF_READ,      // column reads
+  PERF_DEBOUNCE,  // edge stamps and debouncer updates
+  PERF_DISPATCH,  // layer/keymap lookup and event queueing
+  PERF_SCAN,      // whole keyboardScan()
+  PERF_REPORT,    // keyboardReport(): events -> HID reports (loop)
+  PERF_SERIAL,    // checkSerialForReboot() polling, commands excluded (loop)
+  PERF_COMMAND,   // processSerialCommand() (loop)
+  PERF_STAGES,
+};
+
+struct PerfStats {
+  uint32_t samples;
+  uint32_t minCycles;
+  uint32_t maxCycles;
+  uint64_t totalCycles;
+};
+
+class PerfCounter {
+public:
+  void record(uint32_t cycles) {
+    if (!stats.samples || cycles < stats.minCycles) stats.minCycles = cycles;
+    if (cycles > stats.maxCycles) stats.maxCycles = cycles;
+    stats.totalCycles += cycles;
+    ++stats.samples;
+  }
+
+  void reset() { stats = PerfStats(); }
+
+  const PerfStats &getStats() const { return stats; }
+
+private:
+  PerfStats stats = {};
+};
+
+// Lap timer over the scan stages (PERF_SELECT .. PERF_DISPATCH)
+class ScanProfile {
+public:
+  void begin(uint32_t now) {
+    start = now;
+    last = now;
+    ran = 0;
+    for (uint8_t s = 0; s < PERF_SCAN; ++s) acc[s] = 0;
+  }
+
+  // Charges the time since the previous lap to stage
+  void lap(PerfStage stage, uint32_t now) {
+    acc[stage] += now - last;
+    ran |= (uint8_t)(1u << stage);
+    last = now;
+  }
+
+  // Scan done: one sample per stage that ran, and one for the scan
+  void end(uint32_t now, PerfCounter (&out)[PERF_STAGES]) {
+    for (uint8_t s = 0; s < PERF_SCAN; ++s) {
+      if (ran & (1u << s)) out[s].record(acc[s]);
+    }
+    out[PERF_SCAN].record(now - start);
+  }
+
+private:
+  uint32_t start = 0;
+  uint32_t last = 0;
+  uint32_t acc[PERF_SCAN] = {};
+  uint8_t ran = 0;
+};
+
+#endif // PERFPROFILE_H
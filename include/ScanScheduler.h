@@ -0,0 +1,105 @@
+// ScanScheduler.h
+#ifndef SCANSCHEDULER_H
+#define SCANSCHEDULER_H
+
+#include <stdint.h>
+
+// ================================
+// Scan deadlines and jitter counters
+//
+// The scan timer calls onTick() with the current time at the start of every
+// scan. Deadlines advance in whole periods from start(), so one late tick
+// does not shift the ones after it; a tick more than a full period late
+// skips the deadlines it overran.
+// ================================
+
+struct ScanStats {
+  uint32_t ticks;       // scans started
+  uint32_t fastPath;    // scans that ended after the idle any-key probe
+  uint32_t late;        // scans started more than the slack after their deadline
+  uint32_t missed;      // deadlines skipped because a scan overran a period
+  uint32_t maxLateUs;   // worst start lateness
+  uint32_t minPeriodUs; // shortest tick-to-tick interval
+  uint32_t maxPeriodUs; // longest tick-to-tick interval
+};
+
+class ScanScheduler {
+public:
+  void start(uint32_t periodUs, uint32_t lateSlackUs, uint32_t nowUs) {
+    period = periodUs;
+    queued = 0;
+    slack = lateSlackUs;
+    deadline = nowUs + periodUs;
+    lastTick = nowUs;
+    resetStats();
+  }
+
+  // Restarts the deadline grid after the timer was (re)started, keeping stats
+  void resync(uint32_t nowUs, uint32_t periodUs) {
+    period = periodUs;
+    queued = 0;
+    deadline = nowUs + period;
+    lastTick = nowUs;
+  }
+
+  // The timer's period was changed during this tick; like a PIT reload,
+  // it applies from the interval after the one already running
+  void reprogram(uint32_t periodUs) {
+    queued = periodUs;
+  }
+
+  // Returns the number of deadlines skipped before this tick
+  uint32_t onTick(uint32_t nowUs) {
+    if (queued) {
+      period = queued;
+      queued = 0;
+    }
+
+    // A tick slightly ahead of its deadline (timer granularity) is on time
+    const int32_t early = (int32_t)(deadline - nowUs);
+    const uint32_t lateUs = (early >= 0) ? 0 : (uint32_t)(-early);
+
+    const uint32_t skipped = lateUs / period;
+    deadline += (skipped + 1) * period;
+
+    if (stats.ticks) {
+      const uint32_t p = nowUs - lastTick;
+      if (p < stats.minPeriodUs) stats.minPeriodUs = p;
+      if (p > stats.maxPeriodUs) stats.maxPeriodUs = p;
+    }
+    lastTick = nowUs;
+
+    ++stats.ticks;
+    stats.missed += skipped;
+    if (lateUs > slack) ++stats.late;
+    if (lateUs > stats.maxLateUs) stats.maxLateUs = lateUs;
+    return skipped;
+  }
+
+  // Counts a scan that took the idle fast path
+  void onFastPath() { ++stats.fastPath; }
+
+  void resetStats() {
+    stats.ticks = 0;
+    stats.fastPath = 0;
+    stats.late = 0;
+    stats.missed = 0;
+    stats.maxLateUs = 0;
+    stats.minPeriodUs = UINT32_MAX;
+    stats.maxPeriodUs = 0;
+  }
+
+  const ScanStats &getStats() const { return stats; }
+  uint32_t periodUs() const { return period; }
+  uint32_t nextDeadline() const { return deadline; }
+
+private:
+  uint32_t period = 1000;
+  uint32_t queued = 0;
+  uint32_t slack = 0;
+  uint32_t deadline = 0;
+  uint32_t lastTick = 0;
+  ScanStats stats = {};
+};
+
+#endif // SCANSCHEDULER_H
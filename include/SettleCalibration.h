@@ -0,0 +1,107 @@
+// SettleCalibration.h
+#ifndef SETTLECALIBRATION_H
+#define SETTLECALIBRATION_H
+
+#include <stdint.h>
+#include "MatrixIO.h"
+
+// ================================
+// Per-row settle time calibration
+//
+// For one row, a reference word is read after the longest delay, twice; if
+// the two disagree the row is still moving (a key bouncing at boot) and the
+// caller keeps its default. Otherwise delays are tried from 0 upward until
+// stableReads consecutive samples match the reference, and that delay plus
+// a safety margin becomes the row's settle time, never less than
+// floorCycles.
+//
+// With no key held, a row trial only sees the row line fall, not a column
+// recovering from a key in the previous row. The floor is that recovery,
+// measured at boot by calibrateColumnRecovery(): every column is driven
+// LOW, released, and timed until it reads idle again.
+//
+// The sampler is any callable uint32_t(uint8_t row, uint32_t delayCycles)
+// that selects the row, waits, reads and releases it.
+// sampleRowTransition() is the firmware's sampler.
+// ================================
+
+struct SettleCalibrationConfig {
+  uint32_t maxCycles;     // longest delay tried; also the reference delay
+  uint32_t stepCycles;    // delay increment between trials
+  uint8_t stableReads;    // consecutive matching samples required
+  uint8_t marginPercent;  // margin proportional to the measured delay
+  uint32_t marginCycles;  // fixed margin on top
+  uint32_t floorCycles;   // least settle time returned
+};
+
+constexpr uint32_t settleWithMargin(uint32_t measured, const SettleCalibrationConfig &cfg) {
+  return measured + measured * cfg.marginPercent / 100 + cfg.marginCycles > cfg.floorCycles
+             ? measured + measured * cfg.marginPercent / 100 + cfg.marginCycles
+             : cfg.floorCycles;
+}
+
+// The delay search; sample(delayCycles) is one trial
+template <typename Sample>
+bool searchSettle(Sample &&sample, const SettleCalibrationConfig &cfg, uint32_t &out) {
+  const uint32_t reference = sample(cfg.maxCycles);
+  if (sample(cfg.maxCycles) != reference) return false;
+
+  for (uint32_t d = 0; d <= cfg.maxCycles; d += cfg.stepCycles) {
+    uint8_t matches = 0;
+    while (matches < cfg.stableReads && sample(d) == reference) ++matches;
+    if (matches == cfg.stableReads) {
+      out = settleWithMargin(d, cfg);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns false (leaving out untouched) if the row never read consistently
+template <typename Sampler>
+bool calibrateRowSettle(uint8_t row, Sampler &sample, const SettleCalibrationConfig &cfg,
+                        uint32_t &out) {
+  return searchSettle([&](uint32_t d) { return sample(row, d); }, cfg, out);
+}
+
+// One column recovery trial: every column held LOW for holdCycles with the
+// rows released, then returned to its pull-up and read delayCycles later
+inline uint32_t sampleColumnRecovery(uint32_t delayCycles, uint32_t holdCycles) {
+  releaseAllRows();
+  driveColumnsLow();
+  waitSettle(cycleCount(), holdCycles);
+  releaseColumns();
+  waitSettle(cycleCount(), delayCycles);
+  return readColumns();
+}
+
+// Time for the slowest column to read idle after being pulled LOW, plus
+// the margin; false (out untouched) if the columns never settle, e.g. one
+// is stuck LOW
+template <typename Sampler>
+bool calibrateColumnRecovery(Sampler &sample, const SettleCalibrationConfig &cfg, uint32_t &out) {
+  if (sample(cfg.maxCycles) != 0) return false;
+  return searchSettle(sample, cfg, out);
+}
+
+// One trial of the scan's own step into a row: the previous row is held
+// selected for restCycles, then released and this row selected, as the
+// pipelined scan does (row 0 starts from released rows, like a scan). The
+// sample is the column word plus the row line's readback in bit NUM_COLS.
+// A key held in the previous row pulls its column LOW, and the column has
+// to recover through its pull-up before this row reads clean, so with such
+// a key held the search measures that recovery too.
+inline uint32_t sampleRowTransition(uint8_t row, uint32_t delayCycles, uint32_t restCycles) {
+  releaseAllRows();
+  if (row > 0) selectRow((uint8_t)(row - 1));
+  waitSettle(cycleCount(), restCycles);
+
+  if (row > 0) releaseRow((uint8_t)(row - 1));
+  selectRow(row);
+  waitSettle(cycleCount(), delayCycles);
+  const uint32_t sample = readColumns() | ((uint32_t)rowReadsLow(row) << NUM_COLS);
+  releaseRow(row);
+  return sample;
+}
+
+#endif // SETTLECALIBRATION_H
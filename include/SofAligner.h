@@ -0,0 +1,110 @@
+// SofAligner.h
+#ifndef SOFALIGNER_H
+#define SOFALIGNER_H
+
+#include <stdint.h>
+
+// ================================
+// USB start-of-frame phase alignment
+//
+// Steers the scan timer so each scan starts a fixed lead before a USB
+// (micro)frame starts, so the report it produces is queued just before the
+// host polls. The USB interrupt passes SOF timestamps in; every scan tick
+// passes its start time and gets back the period to program next. All
+// times are in the same unit (microseconds on target).
+//
+// The timer only picks up a new period after the interval already running
+// (PIT reload), so each correction accounts for the one still pending.
+// Phase is compared modulo the shorter of the scan period and the SOF
+// interval; one must be a multiple of the other.
+// ================================
+
+struct SofStats {
+  uint32_t sofs;         // SOF interrupts seen
+  uint32_t lockedScans;  // scans that started within the tolerance of the target
+  uint32_t lostScans;    // scans with no recent SOF (suspended, unplugged)
+  uint32_t maxErrorUs;   // worst |phase error| while SOFs were arriving
+};
+
+class SofAligner {
+public:
+  void begin(uint32_t sofInterval, uint32_t scanPeriod, uint32_t lead) {
+    sof = sofInterval;
+    nominal = scanPeriod;
+    window = (scanPeriod < sofInterval) ? scanPeriod : sofInterval;
+    target = window - lead;
+    maxStep = window / 8;
+    restart();
+    resetStats();
+  }
+
+  // The timer was restarted at the nominal period (e.g. after idle)
+  void restart() {
+    pendingDelta = 0;
+    lastError = 0;
+  }
+
+  // SOF interrupt
+  void onSof(uint32_t now) {
+    lastSof = now;
+    haveSof = true;
+    ++stats.sofs;
+  }
+
+  // Scan start; returns the timer period to program for the interval after
+  // the one now running
+  uint32_t onScan(uint32_t now) {
+    if (!haveSof || (now - lastSof) > 4 * sof + nominal) {
+      haveSof = false;
+      ++stats.lostScans;
+      pendingDelta = 0;
+      return nominal;
+    }
+
+    // Phase of this scan within the window, as an error around the target
+    int32_t err = (int32_t)((now - lastSof) % window) - (int32_t)target;
+    if (err >= (int32_t)(window / 2)) err -= (int32_t)window;
+    if (err < -(int32_t)(window / 2)) err += (int32_t)window;
+    lastError = err;
+
+    const uint32_t mag = (uint32_t)(err < 0 ? -err : err);
+    if (mag > stats.maxErrorUs) stats.maxErrorUs = mag;
+    if (mag <= LOCK_TOLERANCE) ++stats.lockedScans;
+
+    // The interval now running already carries pendingDelta; correct half of
+    // the error left after it
+    int32_t delta = -(err + pendingDelta) / 2;
+    if (delta > (int32_t)maxStep) delta = (int32_t)maxStep;
+    if (delta < -(int32_t)maxStep) delta = -(int32_t)maxStep;
+    pendingDelta = delta;
+    return (uint32_t)((int32_t)nominal + delta);
+  }
+
+  // Phase error of the last scan (positive: started late)
+  int32_t phaseError() const { return lastError; }
+
+  void resetStats() {
+    stats.sofs = 0;
+    stats.lockedScans = 0;
+    stats.lostScans = 0;
+    stats.maxErrorUs = 0;
+  }
+
+  const SofStats &getStats() const { return stats; }
+
+  static const uint32_t LOCK_TOLERANCE = 2;
+
+private:
+  uint32_t sof = 1000;
+  uint32_t nominal = 1000;
+  uint32_t window = 1000;
+  uint32_t target = 0;
+  uint32_t maxStep = 0;
+  uint32_t lastSof = 0;
+  bool haveSof = false;
+  int32_t pendingDelta = 0;
+  int32_t lastError = 0;
+  SofStats stats = {};
+};
+
+#endif // SOFALIGNER_H
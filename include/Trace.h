@@ -0,0 +1,96 @@
+// Trace.h
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "Hex.h"
+
+// ================================
+// Binary trace records
+//
+// Hot-path replacement for debugPrintf: a fixed 8-byte record per key
+// event, written to a RAM ring and drained later as hex in [TRACE] lines.
+// trace_decode.py turns them back into the usual PRESS/RELEASE lines, so
+// keep the two in step.
+//
+// Wire format (little-endian): time_us u32, event u8, row<<4|col u8,
+// arg0 u8, arg1 u8. A line is "[TRACE] " and the hex of up to
+// TRACE_LINE_RECORDS records; a full ring's losses go out as
+// "[TRACE] dropped=<n>". test_trace pins this down and
+// "python trace_decode.py --check" decodes the same golden line.
+// ================================
+
+enum TraceEvent : uint8_t {
+  TRACE_PRESS = 0,        // arg0 usage, arg1 mods
+  TRACE_RELEASE,          // arg0 usage, arg1 mods
+  TRACE_PRESS_MOD,        // arg1 mods
+  TRACE_RELEASE_MOD,      // arg1 mods
+  TRACE_PRESS_LAYER,      // arg0 op, arg1 layer
+  TRACE_RELEASE_LAYER,    // arg0 op, arg1 layer
+  TRACE_RESET,            // release all / event queue resync
+};
+
+struct TraceRecord {
+  uint32_t timeUs;
+  uint8_t event;
+  uint8_t rowCol;
+  uint8_t arg0;
+  uint8_t arg1;
+};
+
+static constexpr uint8_t TRACE_RECORD_BYTES = 8;
+
+// Records per [TRACE] line (about one high-speed USB packet of hex)
+static constexpr uint8_t TRACE_LINE_RECORDS = 32;
+static constexpr char TRACE_PREFIX[] = "[TRACE] ";
+static constexpr size_t TRACE_PREFIX_LEN = sizeof(TRACE_PREFIX) - 1;
+static constexpr size_t TRACE_LINE_SIZE = TRACE_PREFIX_LEN + 2 * TRACE_RECORD_BYTES * TRACE_LINE_RECORDS + 2;
+
+constexpr TraceRecord traceRecord(TraceEvent event, uint8_t row, uint8_t col, uint8_t arg0, uint8_t arg1,
+                                  uint32_t timeUs) {
+  return {timeUs, (uint8_t)event, (uint8_t)((row << 4) | (col & 0x0F)), arg0, arg1};
+}
+
+inline void traceEncode(const TraceRecord &rec, uint8_t (&out)[TRACE_RECORD_BYTES]) {
+  out[0] = (uint8_t)rec.timeUs;
+  out[1] = (uint8_t)(rec.timeUs >> 8);
+  out[2] = (uint8_t)(rec.timeUs >> 16);
+  out[3] = (uint8_t)(rec.timeUs >> 24);
+  out[4] = rec.event;
+  out[5] = rec.rowCol;
+  out[6] = rec.arg0;
+  out[7] = rec.arg1;
+}
+
+// Pops up to TRACE_LINE_RECORDS records from the ring into one CRLF
+// terminated line (not NUL terminated); returns its length, 0 if the ring
+// was empty
+template <typename Ring>
+size_t traceFormatLine(Ring &ring, char (&line)[TRACE_LINE_SIZE]) {
+  size_t len = TRACE_PREFIX_LEN;
+  TraceRecord rec;
+  for (uint8_t n = 0; n < TRACE_LINE_RECORDS && ring.pop(rec); ++n) {
+    uint8_t bytes[TRACE_RECORD_BYTES];
+    traceEncode(rec, bytes);
+    char hex[2 * TRACE_RECORD_BYTES + 1];
+    hexEncode(bytes, TRACE_RECORD_BYTES, hex);
+    for (uint8_t i = 0; i < 2 * TRACE_RECORD_BYTES; ++i) line[len++] = hex[i];
+  }
+  if (len == TRACE_PREFIX_LEN) return 0;
+  for (size_t i = 0; i < TRACE_PREFIX_LEN; ++i) line[i] = TRACE_PREFIX[i];
+  line[len++] = '\r';
+  line[len++] = '\n';
+  return len;
+}
+
+// The line reporting records a full ring dropped, CRLF and NUL terminated
+static constexpr size_t TRACE_DROPPED_SIZE = 32;
+
+inline size_t traceFormatDropped(uint32_t count, char (&line)[TRACE_DROPPED_SIZE]) {
+  const int n = snprintf(line, sizeof(line), "%sdropped=%lu\r\n", TRACE_PREFIX, (unsigned long)count);
+  return n > 0 ? (size_t)n : 0;
+}
+
+#endif // TRACE_H
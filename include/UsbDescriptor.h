@@ -0,0 +1,71 @@
+// UsbDescriptor.h
+#ifndef USBDESCRIPTOR_H
+#define USBDESCRIPTOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ================================
+// Interrupt endpoint intervals
+//
+// Full speed: bInterval is the period in 1 ms frames.
+// High speed: the period is 2^(bInterval-1) microframes of 125 us.
+// ================================
+
+static constexpr uint32_t USB_HS_MICROFRAME_US = 125;
+
+constexpr uint32_t interruptIntervalUs(uint8_t bInterval, bool highSpeed) {
+  return highSpeed ? ((bInterval >= 1 && bInterval <= 16) ? (USB_HS_MICROFRAME_US << (bInterval - 1)) : 0)
+                   : (uint32_t)bInterval * 1000u;
+}
+
+// Smallest high-speed bInterval that polls no faster than periodUs
+constexpr uint8_t highSpeedInterval(uint32_t periodUs) {
+  uint8_t b = 1;
+  while (b < 16 && interruptIntervalUs(b, true) < periodUs) ++b;
+  return b;
+}
+
+static_assert(highSpeedInterval(125) == 1 && highSpeedInterval(1000) == 4, "bInterval encoding");
+
+// ================================
+// Configuration descriptor walk
+//
+// Finds the boot keyboard interface (HID class 3, subclass 1, protocol 1)
+// and its interrupt IN endpoint in the bytes the device sends the host.
+// ================================
+
+struct HidEndpointInfo {
+  uint8_t interfaceNumber;
+  uint8_t endpointAddress;
+  uint16_t maxPacket;
+  uint8_t bInterval;
+};
+
+inline bool findKeyboardEndpoint(const uint8_t *cfg, size_t len, HidEndpointInfo &out) {
+  bool inKeyboard = false;
+  size_t i = 0;
+  while (i + 2 <= len) {
+    const uint8_t bLength = cfg[i];
+    const uint8_t type = cfg[i + 1];
+    if (bLength < 2 || i + bLength > len) return false;
+
+    if (type == 0x04 && bLength >= 9) {
+      // Interface: class, subclass, protocol
+      inKeyboard = cfg[i + 5] == 0x03 && cfg[i + 6] == 0x01 && cfg[i + 7] == 0x01;
+      if (inKeyboard) out.interfaceNumber = cfg[i + 2];
+    } else if (type == 0x05 && bLength >= 7 && inKeyboard) {
+      // Endpoint: interrupt IN only
+      if ((cfg[i + 2] & 0x80) && (cfg[i + 3] & 0x03) == 0x03) {
+        out.endpointAddress = cfg[i + 2];
+        out.maxPacket = (uint16_t)((cfg[i + 4] | (cfg[i + 5] << 8)) & 0x07FF);
+        out.bInterval = cfg[i + 6];
+        return true;
+      }
+    }
+    i += bLength;
+  }
+  return false;
+}
+
+#endif // USBDESCRIPTOR_H
@@ -2,6 +2,7 @@
 #define UTILS_H
 
 #include <Arduino.h>
+#include "Trace.h"
 
 //================================
 // PROJECT IDENTITY
@@ -22,10 +23,21 @@
 // Debug setting
 extern bool debugMode;
 
-// Debug print functions - only output if debug mode is enabled
+// Debug print functions - only output if debug mode is enabled.
+// Firmware code logs through the LOG_* macros (Log.h) instead, so
+// disabled levels compile out.
 void debugPrint(const char* message);
 void debugPrintf(const char* format, ...);
 
+// Binary trace for the key path: trace() only queues a record (when debug
+// is on); traceDrain() sends queued records as [TRACE] hex lines without
+// blocking. Call traceDrain() from loop().
+void trace(TraceEvent event, uint8_t row, uint8_t col, uint8_t arg0, uint8_t arg1, uint32_t timeUs);
+void traceDrain();
+
+// Per-subsystem LOG_* front end over debugPrintf() and trace()
+#include "Log.h"
+
 //================================
 // UPLOAD / REBOOT COMMAND HANDLING
 //================================
@@ -0,0 +1,83 @@
+import os
+import sys
+import glob
+import argparse
+import subprocess
+from shutil import which
+
+# Builds two PlatformIO environments and reports the flash and RAM the
+# second one saves over the first. By default that is the debug build
+# (teensy40) against the same firmware with every log level compiled out
+# (teensy40_release).
+#
+#   python size_report.py
+#   python size_report.py --base teensy40 --compare teensy40_release --no-build
+
+# -------------------- CONFIG --------------------
+DEFAULT_PIO_DIR = ".pio/build"
+
+def resolve_size_tool():
+    # Prefer the toolchain PlatformIO installed for the Teensy platform
+    pattern = os.path.expanduser("~/.platformio/packages/toolchain-gccarmnoneeabi*/bin/arm-none-eabi-size")
+    found = sorted(glob.glob(pattern))
+    if found:
+        return found[-1]
+    return which("arm-none-eabi-size")
+
+# -------------------- BUILD --------------------
+def build(envs):
+    cmd = ["pio", "run"]
+    for env in envs:
+        cmd += ["-e", env]
+    print(f"[BUILD] {' '.join(cmd)}")
+    return subprocess.run(cmd).returncode == 0
+
+# -------------------- SIZE --------------------
+def elf_sizes(tool, env, pio_dir=DEFAULT_PIO_DIR):
+    """Returns (text, data, bss) of an environment's firmware.elf, or None."""
+    elf = os.path.join(pio_dir, env, "firmware.elf")
+    if not os.path.exists(elf):
+        print(f"[SIZE] Missing {elf}")
+        return None
+    out = subprocess.run([tool, "-B", elf], capture_output=True, text=True)
+    if out.returncode != 0:
+        print(f"[SIZE] {tool} failed: {out.stderr.strip()}")
+        return None
+    # Berkeley format: header line, then "text data bss dec hex filename"
+    fields = out.stdout.strip().splitlines()[-1].split()
+    return int(fields[0]), int(fields[1]), int(fields[2])
+
+def report(base_env, base, cmp_env, cmp):
+    # Flash holds code plus initialised data; RAM holds initialised plus zeroed data
+    rows = [
+        ("text", base[0], cmp[0]),
+        ("data", base[1], cmp[1]),
+        ("bss", base[2], cmp[2]),
+        ("flash (text+data)", base[0] + base[1], cmp[0] + cmp[1]),
+        ("ram (data+bss)", base[1] + base[2], cmp[1] + cmp[2]),
+    ]
+    print(f"{'':<18} {base_env:>16} {cmp_env:>18} {'saved':>8}")
+    for name, b, c in rows:
+        print(f"{name:<18} {b:>16} {c:>18} {b - c:>8}")
+
+parser = argparse.ArgumentParser(description="Compare firmware size between two PlatformIO environments")
+parser.add_argument("--base", default="teensy40", help="Reference environment (default: teensy40)")
+parser.add_argument("--compare", default="teensy40_release", help="Environment to compare (default: teensy40_release)")
+parser.add_argument("--no-build", action="store_true", help="Use the existing build outputs")
+args = parser.parse_args()
+
+tool = resolve_size_tool()
+if not tool:
+    print("[SIZE] arm-none-eabi-size not found (build once with PlatformIO to install it)")
+    sys.exit(1)
+
+if not args.no_build and not build([args.base, args.compare]):
+    print("[BUILD] Failed")
+    sys.exit(1)
+
+base = elf_sizes(tool, args.base)
+cmp = elf_sizes(tool, args.compare)
+if base is None or cmp is None:
+    sys.exit(1)
+
+report(args.base, base, args.compare, cmp)
@@ -0,0 +1,31 @@
+#include <Arduino.h>
+#include <EEPROM.h>
+#include "KeymapStore.h"
+
+// ================================
+// Keymap image in EEPROM (flash-emulated on Teensy 4.0)
+// ================================
+
+// Image location in EEPROM
+static const int KEYMAP_EEPROM_OFFSET = 0;
+
+#ifdef E2END
+static_assert(KEYMAP_EEPROM_OFFSET + KEYMAP_IMAGE_SIZE <= E2END + 1, "keymap image does not fit in EEPROM");
+#endif
+
+KeymapImageStatus keymapStoreLoad(PackedKeymap &km) {
+  uint8_t image[KEYMAP_IMAGE_SIZE];
+  for (size_t i = 0; i < KEYMAP_IMAGE_SIZE; ++i) image[i] = EEPROM.read(KEYMAP_EEPROM_OFFSET + (int)i);
+  return parseKeymap(image, KEYMAP_IMAGE_SIZE, km);
+}
+
+void keymapStoreSave(const PackedKeymap &km) {
+  uint8_t image[KEYMAP_IMAGE_SIZE];
+  serializeKeymap(km, image);
+  for (size_t i = 0; i < KEYMAP_IMAGE_SIZE; ++i) EEPROM.update(KEYMAP_EEPROM_OFFSET + (int)i, image[i]);
+}
+
+void keymapStoreErase() {
+  // A broken magic is enough; the rest stays as it was
+  EEPROM.update(KEYMAP_EEPROM_OFFSET, 0xFF);
+}
@@ -2,67 +2,108 @@
 #include "Keysend.h"
 #include <Keyboard.h>
 #include "utils.h"
-
-// Matrix
-static const uint8_t NUM_ROWS = 10;
-static const uint8_t NUM_COLS = 14;
+#include "MatrixIO.h"
+#include "Debounce.h"
+#include "ScanScheduler.h"
+#include "IdlePolicy.h"
+#include "SettleCalibration.h"
+#include "HidReport.h"
+#include "KeyReporter.h"
+#include "Keymap.h"
+#include "KeyDispatch.h"
+#include "KeymapImage.h"
+#include "KeymapStore.h"
+#include "EventQueue.h"
+#include "SofAligner.h"
+#include "UsbDescriptor.h"
+#include "KeyLatency.h"
+#include "PerfProfile.h"
+#include "Bench.h"
 
 // Debounce time in milliseconds
 static const uint32_t DEBOUNCE_MS = 5;
 
-// Scan interval in milliseconds
-static const uint32_t SCAN_INTERVAL_MS = 1;
-// Column select settle time in microseconds
+// High-speed polling (-D HID_HIGH_SPEED_POLLING): the keyboard endpoint is
+// polled every 125 us microframe, so scans default to the same rate
+#ifdef HID_HIGH_SPEED_POLLING
+#ifndef KEYBOARD_INTERVAL
+#error "HID_HIGH_SPEED_POLLING needs a USB type with a keyboard (KEYBOARD_INTERVAL from the core's usb_desc.h)"
+#endif
+static_assert(interruptIntervalUs(KEYBOARD_INTERVAL, true) == USB_HS_MICROFRAME_US,
+              "HID_HIGH_SPEED_POLLING needs KEYBOARD_INTERVAL 1 in the core's usb_desc.h");
+#ifndef SCAN_RATE_HZ
+#define SCAN_RATE_HZ 8000
+#endif
+#endif
+
+// Scan rate in Hz, driven by a hardware timer (override with -D SCAN_RATE_HZ=...)
+#ifndef SCAN_RATE_HZ
+#define SCAN_RATE_HZ 1000
+#endif
+static_assert(SCAN_RATE_HZ >= 100 && SCAN_RATE_HZ <= 10000, "SCAN_RATE_HZ out of range");
+static const uint32_t SCAN_PERIOD_US = 1000000UL / SCAN_RATE_HZ;
+// A scan starting later than this after its deadline counts as late
+static const uint32_t SCAN_LATE_SLACK_US = SCAN_PERIOD_US / 4;
+
+// Quiet time before the scanner stops and sleeps until a column edge
+// (override with -D IDLE_QUIET_MS=..., 0 keeps scanning continuously)
+#ifndef IDLE_QUIET_MS
+#define IDLE_QUIET_MS 250
+#endif
+
+// USB start-of-frame alignment (-D SOF_ALIGN): the scan timer is steered so
+// scans start SOF_LEAD_US before a (micro)frame starts. USB_SOF_INTERVAL_US
+// is 1000 for full-speed frames or 125 for high-speed microframes.
+#ifdef SOF_ALIGN
+#ifndef USB_SOF_INTERVAL_US
+#define USB_SOF_INTERVAL_US 125
+#endif
+#ifndef SOF_LEAD_US
+#define SOF_LEAD_US 30
+#endif
+static_assert(USB_SOF_INTERVAL_US == 1000 || USB_SOF_INTERVAL_US == 125, "USB_SOF_INTERVAL_US must be 1000 or 125");
+static_assert(SCAN_PERIOD_US % USB_SOF_INTERVAL_US == 0 || USB_SOF_INTERVAL_US % SCAN_PERIOD_US == 0,
+              "SOF_ALIGN needs the scan period and the SOF interval to be multiples of each other");
+static_assert(SOF_LEAD_US > 0 && SOF_LEAD_US < (SCAN_PERIOD_US < USB_SOF_INTERVAL_US ? SCAN_PERIOD_US : USB_SOF_INTERVAL_US),
+              "SOF_LEAD_US must be shorter than the alignment window");
+#endif
+
+// A raw edge stamp that has not committed this long after it was taken is
+// a glitch, not the start of a debounced change, and is dropped
+static const uint32_t EDGE_STAMP_EXPIRY_MS = 4 * DEBOUNCE_MS;
+
+#ifdef DEBOUNCE_VERTICAL
+// Vertical counter debounce counts scans rather than milliseconds
+static const uint32_t DEBOUNCE_SAMPLES = DEBOUNCE_MS * SCAN_RATE_HZ / 1000;
+static_assert(DEBOUNCE_SAMPLES >= 1 && DEBOUNCE_SAMPLES <= 255,
+              "DEBOUNCE_VERTICAL needs DEBOUNCE_MS to span 1..255 scans at SCAN_RATE_HZ");
+#endif
+
+// Row select settle time in microseconds, used for a row whose boot
+// calibration fails (or for every row with -D SETTLE_FIXED). It is also
+// the floor when the column recovery measurement fails: with no key held
+// at boot, a row trial only sees the row line fall, not a column pulled
+// LOW by a key in the previous row recovering through its pull-up.
 static const uint32_t SELECT_SETTLE_US = 5;
 
-// ================================
-// Matrix pin mapping (Teensy 4.0)
-//
-// COL2ROW diodes: diodes from Column (anode) to Row (cathode).
-// Scanning: drive one ROW LOW at a time, and read COLUMNS with pull-ups.
-// Pressed key => corresponding column reads LOW when its row is selected.
-// ================================
+// Settle calibration: longest delay tried, search step, samples that must
+// agree, and the safety margin added to the measured minimum. The column
+// recovery measurement uses the same settings and, with its margin, is
+// the least settle time a calibrated row gets.
+static const uint32_t SETTLE_CAL_MAX_US = 20;
+static const uint32_t SETTLE_CAL_STEP_NS = 100;
+static const uint8_t SETTLE_CAL_STABLE_READS = 8;
+static const uint8_t SETTLE_MARGIN_PERCENT = 100;
+static const uint32_t SETTLE_MARGIN_NS = 500;
 
-static const uint8_t colPins[NUM_COLS] = {
-  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 14
-};
-
-static const uint8_t rowPins[NUM_ROWS] = {
-  15, 16, 17, 18, 19, 20, 21, 22, 23, 24
-};
+// Matrix geometry and pin mapping live in MatrixIO.h
 
 // Onboard LED pin for Teensy 4.0
 static const uint8_t LED_PIN = 13;
 
-// ================================
-// Key action
-// ================================
-
-// Modifier bitmask
-enum ModMask : uint8_t {
-  MOD_NONE  = 0,
-  MOD_LCTRL = 1 << 0,
-  MOD_LALT  = 1 << 1,
-  MOD_LSHIFT= 1 << 2,
-};
-
-// A key action can be:
-// - a base key (ASCII or KEY_* usage) with optional modifiers (held while pressed)
-// - a pure modifier (e.g., physical Left Shift)
-struct KeyAction {
-  bool valid;           // false: empty position
-  bool modifierOnly;    // true: no base key, only modifiers
-  uint16_t baseKey;     // ASCII or KEY_* usage (Teensy uses 0xF000 marker)
-  ModMask mods;         // modifiers to hold while this key is pressed
-};
-
-// Helper constructors
-static inline KeyAction KA_empty() { return {false, false, 0, MOD_NONE}; }
-static inline KeyAction KA_base(char ascii) { return {true, false, (uint16_t)ascii, MOD_NONE}; }
-static inline KeyAction KA_key(uint16_t keycode) { return {true, false, keycode, MOD_NONE}; }
-static inline KeyAction KA_chord(char ascii, ModMask m) { return {true, false, (uint16_t)ascii, m}; }
-static inline KeyAction KA_chord_key(uint16_t keycode, ModMask m) { return {true, false, keycode, m}; }
-static inline KeyAction KA_mod(ModMask m) { return {true, true, 0, m}; }
+#if defined(ARDUINO) && !defined(LAYOUT_US_ENGLISH)
+#error "Keymap translation assumes the US English keyboard layout"
+#endif
 
 // ================================
 // QMK-derived keymap -> KeyAction
@@ -81,145 +122,421 @@ static constexpr ModMask A = MOD_LALT;
 // Use Teensy core-provided keycodes (from keylayouts.h via Arduino.h)
 // and modifier key codes (MODIFIERKEY_*). Do not redefine them here.
 
-// Matrix mapping: [row][col]
-static const KeyAction keymap[NUM_ROWS][NUM_COLS] = {
-  // Row 0
-  { KA_chord('p', A), KA_chord('n', A), KA_chord('h', A), KA_chord('o', C), KA_chord('u', C),
-    KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty() },
-
-  // Row 1
-  { KA_chord('f', A), KA_chord('u', A), KA_chord('g', A), KA_chord('m', C), KA_chord('c', C),
-    KA_key(KEY_F1), KA_key(KEY_F2), KA_key(KEY_F3), KA_key(KEY_F4), KA_empty(),
-    KA_key(KEY_F5), KA_key(KEY_F6), KA_key(KEY_F7), KA_key(KEY_F8) },
-
-  // Row 2
-  { KA_chord('f', A), KA_chord('d', A), KA_chord('b', A), KA_chord('d', C), KA_chord('l', C),
-    KA_key(KEY_INSERT), KA_key(KEY_HOME), KA_key(KEY_PAGE_UP), KA_key(KEY_F12), KA_empty(),
-    KA_key(KEY_DELETE), KA_key(KEY_END), KA_key(KEY_PAGE_DOWN), KA_key(KEYPAD_PLUS) },
-
-  // Row 3
-  { KA_empty(), KA_empty(), KA_chord('w', A), KA_chord('s', C), KA_chord('h', C),
-    KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty() },
-
-  // Row 4
-  { KA_empty(), KA_empty(), KA_chord('v', A), KA_chord('e', C), KA_chord('z', C),
-    KA_chord('r', A), KA_chord('k', A), KA_chord('z', A), KA_empty(), KA_chord('j', A),
-    KA_empty(), KA_chord('l', A), KA_chord('.', A), KA_chord(',', A) },
-
-  // Row 5
-  { KA_empty(), KA_empty(), KA_chord('[', A), KA_chord('f', C), KA_chord('n', C), KA_chord('g', C),
-    KA_empty(), KA_base('7'), KA_base('8'), KA_base('9'), KA_chord('=', A), KA_empty(), KA_chord('o', A), KA_empty() },
-
-  // Row 6
-  { KA_empty(), KA_empty(), KA_chord(']', A), KA_chord('p', C), KA_chord('q', C), KA_chord('w', C),
-    KA_empty(), KA_base('4'), KA_base('5'), KA_base('6'), KA_chord('t', A), KA_empty(), KA_empty(), KA_empty() },
-
-  // Row 7
-  { KA_empty(), KA_key(KEYPAD_ASTERIX), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(),
-    KA_base('1'), KA_base('2'), KA_base('3'), KA_base('-'), KA_empty(), KA_empty(), KA_empty() },
-
-  // Row 8
-  { KA_empty(), KA_base(']'), KA_chord('\'', A), KA_chord('x', C), KA_chord('a', C), KA_chord('j', C),
-    KA_empty(), KA_base('0'), KA_base('.'), KA_chord('8', A), KA_chord('2', A), KA_empty(), KA_key(KEY_ESC), KA_empty() },
-
-  // Row 9
-  { KA_empty(), KA_base('['), KA_chord(';', A), KA_chord('b', C), KA_empty(), KA_chord('s', A),
-    KA_empty(), KA_mod(MOD_LSHIFT), KA_chord('/', C), KA_empty(), KA_key(KEY_ENTER), KA_empty(), KA_chord_key(KEY_BACKSPACE, A), KA_chord('y', A) }
+// Matrix mapping: [layer][row][col] (source form; only the packed table below ships)
+//
+// Empty positions on layers above 0 fall through to the layer below. No
+// base position holds a layer key, so the Fn layer is unreachable until
+// one is bound: KA_momentary(LAYER_FN), KA_toggle(LAYER_FN) or
+// KA_oneshot(LAYER_FN) here, or at runtime from the serial console (packed
+// actions: momentary 9001, toggle A001, one-shot B001), e.g. a momentary
+// Fn key on the free row 0, column 5 and an F9 under row 1, column 5:
+//
+//   KEYMAP_SET 0 0 5 9001
+//   KEYMAP_SET 1 1 5 0042
+//   KEYMAP_SAVE
+static constexpr KeyAction keymap[NUM_LAYERS][NUM_ROWS][NUM_COLS] = {
+  // Layer 0: base
+  {
+    // Row 0
+    { KA_chord('p', A), KA_chord('n', A), KA_chord('h', A), KA_chord('o', C), KA_chord('u', C),
+      KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty() },
+
+    // Row 1
+    { KA_chord('f', A), KA_chord('u', A), KA_chord('g', A), KA_chord('m', C), KA_chord('c', C),
+      KA_key(KEY_F1), KA_key(KEY_F2), KA_key(KEY_F3), KA_key(KEY_F4), KA_empty(),
+      KA_key(KEY_F5), KA_key(KEY_F6), KA_key(KEY_F7), KA_key(KEY_F8) },
+
+    // Row 2
+    { KA_chord('f', A), KA_chord('d', A), KA_chord('b', A), KA_chord('d', C), KA_chord('l', C),
+      KA_key(KEY_INSERT), KA_key(KEY_HOME), KA_key(KEY_PAGE_UP), KA_key(KEY_F12), KA_empty(),
+      KA_key(KEY_DELETE), KA_key(KEY_END), KA_key(KEY_PAGE_DOWN), KA_key(KEYPAD_PLUS) },
+
+    // Row 3
+    { KA_empty(), KA_empty(), KA_chord('w', A), KA_chord('s', C), KA_chord('h', C),
+      KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty() },
+
+    // Row 4
+    { KA_empty(), KA_empty(), KA_chord('v', A), KA_chord('e', C), KA_chord('z', C),
+      KA_chord('r', A), KA_chord('k', A), KA_chord('z', A), KA_empty(), KA_chord('j', A),
+      KA_empty(), KA_chord('l', A), KA_chord('.', A), KA_chord(',', A) },
+
+    // Row 5
+    { KA_empty(), KA_empty(), KA_chord('[', A), KA_chord('f', C), KA_chord('n', C), KA_chord('g', C),
+      KA_empty(), KA_base('7'), KA_base('8'), KA_base('9'), KA_chord('=', A), KA_empty(), KA_chord('o', A), KA_empty() },
+
+    // Row 6
+    { KA_empty(), KA_empty(), KA_chord(']', A), KA_chord('p', C), KA_chord('q', C), KA_chord('w', C),
+      KA_empty(), KA_base('4'), KA_base('5'), KA_base('6'), KA_chord('t', A), KA_empty(), KA_empty(), KA_empty() },
+
+    // Row 7
+    { KA_empty(), KA_key(KEYPAD_ASTERIX), KA_empty(), KA_empty(), KA_empty(), KA_empty(), KA_empty(),
+      KA_base('1'), KA_base('2'), KA_base('3'), KA_base('-'), KA_empty(), KA_empty(), KA_empty() },
+
+    // Row 8
+    { KA_empty(), KA_base(']'), KA_chord('\'', A), KA_chord('x', C), KA_chord('a', C), KA_chord('j', C),
+      KA_empty(), KA_base('0'), KA_base('.'), KA_chord('8', A), KA_chord('2', A), KA_empty(), KA_key(KEY_ESC), KA_empty() },
+
+    // Row 9
+    { KA_empty(), KA_base('['), KA_chord(';', A), KA_chord('b', C), KA_empty(), KA_chord('s', A),
+      KA_empty(), KA_mod(MOD_LSHIFT), KA_chord('/', C), KA_empty(), KA_key(KEY_ENTER), KA_empty(), KA_chord_key(KEY_BACKSPACE, A), KA_chord('y', A) }
+  },
+
+  // Layer 1: Fn (all transparent until assigned, see above)
+  {}
 };
 
+static_assert(keymapTranslated(keymap), "keymap has a key with no HID usage in the US layout");
+
+// Packed 16-bit actions plus per-row masks of columns populated on any layer;
+// the fallback when EEPROM holds no valid keymap image
+static constexpr PackedKeymap defaultKeymap = packKeymap(keymap);
+static_assert(keymapActionsValid(defaultKeymap), "default keymap does not survive an image round trip");
+
+// Scan -> reporter event queue. The scan resolves each committed change to
+// an action and queues it; the reporter in loop() turns the events into HID
+// reports, so a busy USB endpoint never stalls a scan.
+static const uint16_t EVENT_QUEUE_SIZE = 64;
+static SpscQueue<KeyEvent, EVENT_QUEUE_SIZE> events;
+
+// Active layers, held actions and replays (scan side)
+static KeyDispatcher<EVENT_QUEUE_SIZE> keys(events);
+
 // ================================
-// Matrix state & debounce
+// Keymap profiles
+//
+// Profiles are PackedKeymaps in RAM, owned by loop(). The scan reads a
+// ResolvedKeymap; a switch resolves the new profile into the buffer the
+// scan is not using and publishes it through pendingKeymap, and the scan
+// adopts it at its next start (a pointer swap), never mid-scan.
 // ================================
 
-static bool rawState[NUM_ROWS][NUM_COLS];       // instant reads
-static bool lastRaw[NUM_ROWS][NUM_COLS];        // previous raw for debounce timing
-static bool debounced[NUM_ROWS][NUM_COLS];      // stable state
-static uint32_t lastChange[NUM_ROWS][NUM_COLS]; // time of last raw change
+struct KeymapProfile {
+  char name[PROFILE_NAME_LEN + 1];  // empty: unused slot
+  KeymapSource source;
+  PackedKeymap keymap;
+};
 
-// Modifier reference counts (to keep them held while any chord needs them)
-static uint16_t refCtrl = 0;
-static uint16_t refAlt  = 0;
-static uint16_t refShift= 0;
+static KeymapProfile profiles[KEYMAP_PROFILES];
+static uint8_t activeProfile = 0;
 
-// Count of currently pressed keys (for LED debug indication)
-static uint16_t pressedCount = 0;
+static ResolvedKeymap resolvedBuffers[2];
+static const ResolvedKeymap *volatile pendingKeymap = nullptr;
+
+// Called from loop(): resolves km and queues it for the next scan
+static void scheduleKeymap(const PackedKeymap &km) {
+  // Withdraw a switch the scan has not taken yet, so its buffer is free
+  noInterrupts();
+  pendingKeymap = nullptr;
+  const ResolvedKeymap *front = &keys.layers().resolved();
+  interrupts();
+
+  ResolvedKeymap *back = (front == &resolvedBuffers[0]) ? &resolvedBuffers[1] : &resolvedBuffers[0];
+  resolveKeymap(km, *back);
+  pendingKeymap = back;
+}
 
 // ================================
-// GPIO helpers
+// Matrix state & debounce
 // ================================
 
-static void unselectAllRows() {
+// Edge policies: -D DEBOUNCE_PRESS_EAGER / -D DEBOUNCE_RELEASE_EAGER report
+// that edge on first contact instead of after DEBOUNCE_MS of stable reads
+#ifdef DEBOUNCE_PRESS_EAGER
+static const DebouncePolicy PRESS_POLICY = DEBOUNCE_EAGER;
+#else
+static const DebouncePolicy PRESS_POLICY = DEBOUNCE_DEFER;
+#endif
+#ifdef DEBOUNCE_RELEASE_EAGER
+static const DebouncePolicy RELEASE_POLICY = DEBOUNCE_EAGER;
+#else
+static const DebouncePolicy RELEASE_POLICY = DEBOUNCE_DEFER;
+#endif
+
+// Build with -D DEBOUNCE_VERTICAL to select the bit-sliced vertical counter
+#ifdef DEBOUNCE_VERTICAL
+#if defined(DEBOUNCE_PRESS_EAGER) || defined(DEBOUNCE_RELEASE_EAGER)
+#error "Eager debounce policies require the timestamp debouncer"
+#endif
+static VerticalCounterDebouncer<DEBOUNCE_SAMPLES> debouncer;
+#else
+static TimestampDebouncer<DEBOUNCE_MS, PRESS_POLICY, RELEASE_POLICY> debouncer;
+#endif
+
+// Latency stamps of keys that differ from their debounced state
+static EdgeStamps edges;
+
+// Per-row settle time in CPU cycles (calibrated at init), and the longest
+// of them for the all-rows probe
+static uint32_t rowSettleCycles[NUM_ROWS];
+static uint32_t probeSettleCycles = 0;
+// Rows that kept SELECT_SETTLE_US (calibration unstable, or SETTLE_FIXED)
+static uint16_t settleDefaultRows = 0;
+// Measured column pull-up recovery plus margin, the calibrated rows' floor
+// (0 with SETTLE_FIXED)
+static uint32_t columnRecoveryCycles = 0;
+
+// Scan timer and its deadline/jitter bookkeeping
+static IntervalTimer scanTimer;
+static ScanScheduler scheduler;
+
+// Sleep-until-edge state (entered from the scan timer, left from a column IRQ)
+static IdlePolicy idlePolicy;
+
+// Stage profiler: the scan stages belong to the scan timer, the report and
+// serial stages to loop()
+#if PERF_PROFILE
+static ScanProfile scanProfile;
+static PerfCounter perf[PERF_STAGES];
+#define PERF_BEGIN() scanProfile.begin(cycleCount())
+#define PERF_LAP(stage) scanProfile.lap(stage, cycleCount())
+#define PERF_END() scanProfile.end(cycleCount(), perf)
+#else
+#define PERF_BEGIN() do {} while (0)
+#define PERF_LAP(stage) do {} while (0)
+#define PERF_END() do {} while (0)
+#endif
+
+#ifdef SOF_ALIGN
+// Steers the scan timer phase from SOF timestamps
+static SofAligner sofAligner;
+
+// Core USB interrupt handler, chained from usbIsrWithSof()
+static void (*coreUsbIsr)(void) = nullptr;
+
+// Timestamps the SOF before the core handler acknowledges it (the core has
+// no SOF callback; usb_start_sof_interrupts() only enables the interrupt)
+static void usbIsrWithSof() {
+  if ((USB1_USBSTS & USB_USBSTS_SRI) && (USB1_USBINTR & USB_USBINTR_SRE)) sofAligner.onSof(micros());
+  coreUsbIsr();
+}
+#endif
+
+// Count of currently pressed keys (for LED debug indication)
+static uint16_t pressedCount() {
+  uint16_t n = 0;
   for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    pinMode(rowPins[r], INPUT); // Hi-Z when not selected
+    n += (uint16_t)__builtin_popcount(debouncer.state(r));
   }
+  return n;
 }
 
-static void selectRowLow(uint8_t row) {
-  // Unselect others (Hi-Z)
+// ================================
+// Handlers (scan side)
+// ================================
+
+static void releaseAllNow() {
+  keys.releaseAll();
   for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    if (r == row) continue;
-    pinMode(rowPins[r], INPUT);
+    debouncer.clear(r);
+    edges.clear(r);
   }
-  // Selected row actively driven LOW
-  pinMode(rowPins[row], OUTPUT);
-  digitalWrite(rowPins[row], LOW);
+  digitalWrite(LED_PIN, LOW);
 }
 
 // ================================
-// Modifier press/release helpers
+// Reporter (loop side)
 // ================================
 
-static void pressModifiers(ModMask m) {
-  if (m & MOD_LCTRL) { if (refCtrl++ == 0) Keyboard.press(MODIFIERKEY_LEFT_CTRL); }
-  if (m & MOD_LALT)  { if (refAlt++  == 0) Keyboard.press(MODIFIERKEY_LEFT_ALT); }
-  if (m & MOD_LSHIFT){ if (refShift++== 0) Keyboard.press(MODIFIERKEY_LEFT_SHIFT); }
+// Report being built from the current scan's events (sent once per scan)
+static KeyReporter reporter;
+
+// Latency of the key events in the report being built, recorded once it is
+// handed to USB
+static KeyLatency latency;
+
+// Sends the scan's report in one USB transfer, only if it changed
+static void flushReport() {
+  KeyboardReport rep;
+  if (!reporter.takeChanged(rep)) {
+    latency.discard();
+    return;
+  }
+  Keyboard.set_modifier(rep.mods);
+  Keyboard.set_key1(rep.keys[0]);
+  Keyboard.set_key2(rep.keys[1]);
+  Keyboard.set_key3(rep.keys[2]);
+  Keyboard.set_key4(rep.keys[3]);
+  Keyboard.set_key5(rep.keys[4]);
+  Keyboard.set_key6(rep.keys[5]);
+  Keyboard.send_now();
+  latency.sent(cycleCount());
 }
 
-static void releaseModifiers(ModMask m) {
-  if (m & MOD_LCTRL) { if (refCtrl > 0 && --refCtrl == 0) Keyboard.release(MODIFIERKEY_LEFT_CTRL); }
-  if (m & MOD_LALT)  { if (refAlt  > 0 && --refAlt  == 0) Keyboard.release(MODIFIERKEY_LEFT_ALT); }
-  if (m & MOD_LSHIFT){ if (refShift> 0 && --refShift== 0) Keyboard.release(MODIFIERKEY_LEFT_SHIFT); }
+// Trace of what an event did to the report
+static void traceEvent(const KeyEvent &ev, uint8_t r, uint8_t c, uint32_t timeUs) {
+  const PackedAction a = ev.action;
+  const bool press = ev.type == KEY_EVENT_PRESS;
+
+  if (ev.type == KEY_EVENT_RESET) {
+    LOG_HID_TRACE(TRACE_RESET, 0, 0, 0, 0, timeUs);
+  } else if (isLayerAction(a)) {
+    LOG_HID_TRACE(press ? TRACE_PRESS_LAYER : TRACE_RELEASE_LAYER, r, c,
+                  actionLayerOp(a), actionLayer(a), timeUs);
+  } else if (!actionUsage(a)) {
+    // Physical modifier key (e.g., Left Shift)
+    LOG_HID_TRACE(press ? TRACE_PRESS_MOD : TRACE_RELEASE_MOD, r, c, 0, actionMods(a), timeUs);
+  } else {
+    LOG_HID_TRACE(press ? TRACE_PRESS : TRACE_RELEASE, r, c, actionUsage(a), actionMods(a), timeUs);
+  }
+}
+
+static void applyEvent(const KeyEvent &ev) {
+  const uint8_t r = (uint8_t)(ev.pos / NUM_COLS);
+  const uint8_t c = (uint8_t)(ev.pos % NUM_COLS);
+  // Trace time is when the scan committed the change, not when it got here
+#if LOG_LEVEL_HID >= LOG_LEVEL_DEBUG
+  const uint32_t timeUs = micros() - (cycleCount() - ev.cycles) / cyclesPerUs();
+#else
+  const uint32_t timeUs = 0;
+#endif
+  latency.note(ev);
+  reporter.apply(ev);
+  traceEvent(ev, r, c, timeUs);
 }
 
 // ================================
-// Handlers
+// Settle calibration
 // ================================
 
-static void handleKeyPress(uint8_t r, uint8_t c) {
-  const KeyAction &ka = keymap[r][c];
-  if (!ka.valid) return;
+#ifndef SETTLE_FIXED
+// One calibration trial of the step from the previous row into this one
+static uint32_t sampleRowAfter(uint8_t row, uint32_t delayCycles) {
+  return sampleRowTransition(row, delayCycles, SETTLE_CAL_MAX_US * cyclesPerUs());
+}
 
-  if (ka.modifierOnly) {
-    // Physical modifier key (e.g., Left Shift)
-    pressModifiers(ka.mods);
-    debugPrintf("PRESS MOD r=%u c=%u mods=%u", r, c, (unsigned)ka.mods);
-    if (++pressedCount == 1) digitalWrite(LED_PIN, HIGH);
-    return;
+// One trial of the columns rising after being held LOW
+static uint32_t sampleColumnsAfter(uint32_t delayCycles) {
+  return sampleColumnRecovery(delayCycles, SETTLE_CAL_MAX_US * cyclesPerUs());
+}
+#endif
+
+static void calibrateSettle() {
+  const uint32_t perUs = cyclesPerUs();
+#ifndef SETTLE_FIXED
+  SettleCalibrationConfig cfg = {
+    SETTLE_CAL_MAX_US * perUs,
+    SETTLE_CAL_STEP_NS * perUs / 1000,
+    SETTLE_CAL_STABLE_READS,
+    SETTLE_MARGIN_PERCENT,
+    SETTLE_MARGIN_NS * perUs / 1000,
+    0,
+  };
+
+  // Column pull-up recovery bounds every row from below
+  uint32_t recovery = SELECT_SETTLE_US * perUs;
+  if (!calibrateColumnRecovery(sampleColumnsAfter, cfg, recovery)) {
+    LOG_SCAN_ERROR("Column recovery calibration failed, rows floored at %u us", (unsigned)SELECT_SETTLE_US);
+  }
+  columnRecoveryCycles = recovery;
+  cfg.floorCycles = recovery;
+  LOG_SCAN_DEBUG("Column recovery: %u cycles", (unsigned)recovery);
+#endif
+
+  probeSettleCycles = 0;
+  settleDefaultRows = 0;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    uint32_t cycles = SELECT_SETTLE_US * perUs;
+#ifndef SETTLE_FIXED
+    uint32_t measured = 0;
+    if (calibrateRowSettle(r, sampleRowAfter, cfg, measured)) {
+      cycles = measured;
+    } else {
+      LOG_SCAN_ERROR("Row %u settle calibration unstable, using %u us", r, (unsigned)SELECT_SETTLE_US);
+      settleDefaultRows |= (uint16_t)(1u << r);
+    }
+#else
+    settleDefaultRows |= (uint16_t)(1u << r);
+#endif
+    rowSettleCycles[r] = cycles;
+    if (cycles > probeSettleCycles) probeSettleCycles = cycles;
+    LOG_SCAN_DEBUG("Row %u settle: %u cycles", r, (unsigned)cycles);
+  }
+  releaseAllRows();
+}
+
+// ================================
+// Idle: sleep until a column edge
+// ================================
+
+static void scanTick();
+
+static void disarmColumnWake() {
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    detachInterrupt(colPins[c]);
   }
+}
 
-  // Press modifiers first, then base key
-  if (ka.mods != MOD_NONE) pressModifiers(ka.mods);
-  Keyboard.press(ka.baseKey);
-  debugPrintf("PRESS r=%u c=%u key=%u mods=%u", r, c, (unsigned)ka.baseKey, (unsigned)ka.mods);
-  if (++pressedCount == 1) digitalWrite(LED_PIN, HIGH);
+// Restarts the scan grid from now. The SOF aligner, its interrupts and the
+// scan timer change together with interrupts masked, so an SOF or a scan
+// tick never sees one restarted without the other, and the restart cannot
+// interleave with enterIdle()'s stop.
+static void restartScanning(uint32_t now) {
+  noInterrupts();
+  scheduler.resync(now, SCAN_PERIOD_US);
+#ifdef SOF_ALIGN
+  sofAligner.restart();
+  usb_start_sof_interrupts(KEYBOARD_INTERFACE);
+#endif
+  scanTimer.begin(scanTick, SCAN_PERIOD_US);
+  interrupts();
 }
 
-static void handleKeyRelease(uint8_t r, uint8_t c) {
-  const KeyAction &ka = keymap[r][c];
-  if (!ka.valid) return;
+// Column edge IRQ: stop listening, scan straight away, resume the timer
+static void columnWake() {
+  if (!idlePolicy.onWakeEdge(micros())) return;
+  disarmColumnWake();
+  releaseAllRows();
 
-  if (ka.modifierOnly) {
-    releaseModifiers(ka.mods);
-    debugPrintf("RELEASE MOD r=%u c=%u mods=%u", r, c, (unsigned)ka.mods);
-    if (pressedCount > 0 && --pressedCount == 0) digitalWrite(LED_PIN, LOW);
+  keyboardScan();
+  const uint32_t now = micros();
+  idlePolicy.onScan(!debouncer.idle(), now);
+  restartScanning(now);
+}
+
+// Drives all rows LOW and arms the column edges; stops the scan timer
+// unless a column is already LOW (an edge that beat the arming). Masked
+// from the arming to scanTimer.end(): an edge in between stays pending in
+// the GPIO status and wakes the scan once the timer is down, and no other
+// interrupt can see the timer running with the edges armed.
+static void enterIdle(uint32_t now) {
+  noInterrupts();
+  selectAllRows();
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    attachInterrupt(colPins[c], columnWake, FALLING);
+  }
+  waitSettle(cycleCount(), probeSettleCycles);
+
+  if (idlePolicy.enterIdle((readColumns() & keys.layers().resolved().validColumns) != 0, now)) {
+    scanTimer.end();
+#ifdef SOF_ALIGN
+    // SOFs would wake the core every (micro)frame
+    usb_stop_sof_interrupts(KEYBOARD_INTERFACE);
+#endif
+    interrupts();
     return;
   }
+  disarmColumnWake();
+  releaseAllRows();
+  interrupts();
+}
 
-  // Release base key first, then modifiers if no other keys need them
-  Keyboard.release(ka.baseKey);
-  if (ka.mods != MOD_NONE) releaseModifiers(ka.mods);
-  debugPrintf("RELEASE r=%u c=%u key=%u mods=%u", r, c, (unsigned)ka.baseKey, (unsigned)ka.mods);
-  if (pressedCount > 0 && --pressedCount == 0) digitalWrite(LED_PIN, LOW);
+// Scan timer ISR: account the tick against its deadline, then scan
+static void scanTick() {
+  const uint32_t now = micros();
+  scheduler.onTick(now);
+#ifdef SOF_ALIGN
+  // Nudge the next period toward the SOF phase target; masked against the
+  // USB interrupt's onSof() and anything that stops or restarts the timer
+  noInterrupts();
+  const uint32_t next = sofAligner.onScan(now);
+  scanTimer.update(next);
+  scheduler.reprogram(next);
+  interrupts();
+#endif
+  keyboardScan();
+
+  idlePolicy.onScan(!debouncer.idle(), now);
+  if (idlePolicy.shouldEnterIdle(now)) enterIdle(now);
 }
 
 void keyboardInit() {
@@ -230,80 +547,388 @@ void keyboardInit() {
   for (uint8_t c = 0; c < NUM_COLS; ++c) {
     pinMode(colPins[c], INPUT_PULLUP);
   }
-  // Unselect all rows (Hi-Z)
-  unselectAllRows();
+  // Rows are open-drain outputs: released (Hi-Z) before switching them to output
+  releaseAllRows();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    pinMode(rowPins[r], OUTPUT_OPENDRAIN);
+  }
+
+  // Measure how long each row takes to settle (rows and columns are live now)
+  calibrateSettle();
 
   // Initialize onboard LED
   pinMode(LED_PIN, OUTPUT);
   digitalWrite(LED_PIN, LOW);
 
-  // Initialize state
-  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    for (uint8_t c = 0; c < NUM_COLS; ++c) {
-      rawState[r][c] = false;
-      lastRaw[r][c] = false;
-      debounced[r][c] = false;
-      lastChange[r][c] = 0;
-    }
+  // Profile 0 is the boot keymap: stored image if it checks out, else the
+  // compiled-in one
+  KeymapProfile &boot = profiles[0];
+  strcpy(boot.name, "main");
+  const KeymapImageStatus stored = keymapStoreLoad(boot.keymap);
+  if (stored == KEYMAP_IMAGE_OK) {
+    boot.source = KEYMAP_SOURCE_STORED;
+  } else {
+    boot.keymap = defaultKeymap;
+    boot.source = KEYMAP_SOURCE_DEFAULT;
   }
+  resolveKeymap(boot.keymap, resolvedBuffers[0]);
+  LOG_HID_INFO("Keymap: %s (stored image status %u)",
+              boot.source == KEYMAP_SOURCE_STORED ? "EEPROM" : "default", (unsigned)stored);
 
-  debugPrint("Keyboard matrix initialized (Teensy 4.0, COL2ROW)");
+  // Initialize state
+  debouncer.reset();
+  keys.begin(resolvedBuffers[0]);
+
+  LOG_SCAN_INFO("Keyboard matrix initialized (Teensy 4.0, COL2ROW)");
+
+  // Start periodic scanning; loop() stays free for serial and housekeeping
+  scheduler.start(SCAN_PERIOD_US, SCAN_LATE_SLACK_US, micros());
+  idlePolicy.begin(IDLE_QUIET_MS * 1000UL, micros());
+#ifdef SOF_ALIGN
+  sofAligner.begin(USB_SOF_INTERVAL_US, SCAN_PERIOD_US, SOF_LEAD_US);
+  coreUsbIsr = _VectorsRam[IRQ_USB1 + 16];
+  attachInterruptVector(IRQ_USB1, usbIsrWithSof);
+  usb_start_sof_interrupts(KEYBOARD_INTERFACE);
+  LOG_SCAN_INFO("SOF alignment: %u us frames, %u us lead", (unsigned)USB_SOF_INTERVAL_US, (unsigned)SOF_LEAD_US);
+#endif
+  scanTimer.begin(scanTick, SCAN_PERIOD_US);
+  LOG_SCAN_INFO("Scan timer started: %u Hz", (unsigned)SCAN_RATE_HZ);
+}
+
+// Debounces one captured row and dispatches its committed changes
+static bool processRow(uint8_t r, uint16_t raw, uint32_t now, uint32_t readAt) {
+  edges.stamp(r, raw ^ debouncer.state(r), readAt, EDGE_STAMP_EXPIRY_MS * 1000 * cyclesPerUs());
+  uint16_t flipped = debouncer.update(r, raw, now);
+  PERF_LAP(PERF_DEBOUNCE);
+  if (!flipped) return false;
+
+  const uint16_t state = debouncer.state(r);
+  edges.commit(r, flipped);
+  while (flipped) {
+    const uint8_t c = (uint8_t)__builtin_ctz(flipped);
+    flipped &= (uint16_t)(flipped - 1);
+    if (state & (1u << c)) keys.press(r, c, edges.at(r, c));
+    else keys.release(r, c, edges.at(r, c));
+  }
+  PERF_LAP(PERF_DISPATCH);
+  return true;
 }
 
 void keyboardScan() {
+  PERF_BEGIN();
   const uint32_t now = millis();
+  bool committed = false;
 
-  // 1) Scan all rows (COL2ROW): select row low, read columns
-  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    selectRowLow(r);
-    if (SELECT_SETTLE_US) delayMicroseconds(SELECT_SETTLE_US);
-    for (uint8_t c = 0; c < NUM_COLS; ++c) {
-      // Pressed if column reads LOW when this row is selected
-      bool pressed = (digitalRead(colPins[c]) == LOW);
-      rawState[r][c] = pressed;
+  // Keymap switches land here, between scans
+  const ResolvedKeymap *next = pendingKeymap;
+  if (next) {
+    keys.layers().setKeymap(*next);
+    pendingKeymap = nullptr;
+  }
+  const ResolvedKeymap &km = keys.layers().resolved();
+
+  // Events queued by this scan share one report
+  if (keys.beginScan()) PERF_LAP(PERF_DISPATCH);
+
+  // Idle fast path: with no key held or settling, drive every row LOW and
+  // read the columns once; the per-row scan only runs if one of them is low
+  if (debouncer.idle()) {
+    selectAllRows();
+    waitSettle(cycleCount(), probeSettleCycles);
+    PERF_LAP(PERF_SELECT);
+    const uint16_t anyPressed = readColumns() & km.validColumns;
+    PERF_LAP(PERF_READ);
+    releaseAllRows();
+    PERF_LAP(PERF_SELECT);
+    if (!anyPressed) {
+      // A bounce that settled back without committing leaves its stamp
+      // armed; drop it so the next edge on that key is stamped afresh
+      edges.clearAll();
+      scheduler.onFastPath();
+      PERF_END();
+      return;
     }
   }
-  // Restore rows to Hi-Z
-  unselectAllRows();
 
-  // 2) Debounce and dispatch events on stable changes
+  // Pipelined scan (COL2ROW): while row r+1 settles, row r is debounced and
+  // dispatched, so the settle time is spent on useful work
+  selectRow(0);
+  uint32_t selectedAt = cycleCount();
   for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    for (uint8_t c = 0; c < NUM_COLS; ++c) {
-      bool currRaw = rawState[r][c];
-      if (currRaw != lastRaw[r][c]) {
-        // Raw changed: reset timer
-        lastRaw[r][c] = currRaw;
-        lastChange[r][c] = now;
-      }
-
-      // If debounced differs from current raw and it's been stable long enough, commit
-      if (debounced[r][c] != currRaw && (now - lastChange[r][c]) >= DEBOUNCE_MS) {
-        debounced[r][c] = currRaw;
-        if (currRaw) handleKeyPress(r, c);
-        else handleKeyRelease(r, c);
-      }
+    // Wait out whatever is left of this row's settle time
+    waitSettle(selectedAt, rowSettleCycles[r]);
+    PERF_LAP(PERF_SELECT);
+    // Pressed if column reads LOW when this row is selected; unpopulated
+    // positions are masked off so they never reach debounce or dispatch
+    const uint16_t raw = readColumns() & km.validRows[r];
+    const uint32_t readAt = cycleCount();
+    PERF_LAP(PERF_READ);
+    releaseRow(r);
+
+    if (r + 1 < NUM_ROWS) {
+      selectRow(r + 1);
+      selectedAt = cycleCount();
     }
+    PERF_LAP(PERF_SELECT);
+    if (processRow(r, raw, now, readAt)) committed = true;
+  }
+
+  if (committed) {
+    digitalWrite(LED_PIN, pressedCount() ? HIGH : LOW);
+    PERF_LAP(PERF_DISPATCH);
   }
+  PERF_END();
+}
 
-  // 3) Pace scanning
-  if (SCAN_INTERVAL_MS) delay(SCAN_INTERVAL_MS);
+bool keyboardBench(BenchScenario scenario, uint32_t iterations, BenchResult &out) {
+  if (scenario >= BENCH_SCENARIOS) return false;
+
+  // Take the matrix over: no scans and no column wakes until done. Other
+  // interrupts (USB) stay on.
+  noInterrupts();
+  scanTimer.end();
+  disarmColumnWake();
+#ifdef SOF_ALIGN
+  usb_stop_sof_interrupts(KEYBOARD_INTERFACE);
+#endif
+  interrupts();
+  releaseAllRows();
+
+  // Release every key on the host first, or a key held now stays down
+  // there for the whole run. This comes after the timer stops, so no
+  // scan can press the key again before the empty report goes out.
+  keyboardReleaseAll();
+  keyboardReport();
+
+  static ScanBench<decltype(debouncer), EVENT_QUEUE_SIZE> bench;
+  bench.run(scenario, iterations, SCAN_PERIOD_US, keys.layers().resolved(), rowSettleCycles, cycleCount, out);
+
+  // Resume as after an idle wake, but with the debouncer's raw history
+  // and the dispatcher reset, so a key still held reports as a fresh press
+  releaseAllRows();
+  debouncer.reset();
+  releaseAllNow();
+  const uint32_t now = micros();
+  idlePolicy.resume(now);
+  restartScanning(now);
+  return true;
 }
 
 void keyboardReleaseAll() {
-  // Release any held base keys by walking the debounced matrix
-  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
-    for (uint8_t c = 0; c < NUM_COLS; ++c) {
-      if (debounced[r][c]) {
-        handleKeyRelease(r, c);
-        debounced[r][c] = false;
-      }
-    }
+  // Done here with the scan held off rather than left to the next scan, so
+  // it also works while the scan timer is stopped (idle sleep, BENCH). The
+  // reset is queued now and goes out with the next keyboardReport(). A key
+  // still held commits again as a press on the next scan, since the
+  // debouncer keeps its raw history.
+  noInterrupts();
+  releaseAllNow();
+  keys.beginScan();
+  interrupts();
+}
+
+void keyboardReport() {
+#if PERF_PROFILE
+  const uint32_t started = cycleCount();
+#endif
+  // Events of one scan are contiguous and a scan never shows up half
+  // queued (it runs in an interrupt), so a change of scan number marks
+  // the end of a report
+  KeyEvent ev;
+  bool pending = false;
+  uint16_t scan = 0;
+  while (events.pop(ev)) {
+    if (pending && ev.scan != scan) flushReport();
+    scan = ev.scan;
+    pending = true;
+    applyEvent(ev);
   }
-  // Ensure all modifiers are released
-  if (refCtrl) { Keyboard.release(MODIFIERKEY_LEFT_CTRL); refCtrl = 0; }
-  if (refAlt)  { Keyboard.release(MODIFIERKEY_LEFT_ALT);  refAlt  = 0; }
-  if (refShift){ Keyboard.release(MODIFIERKEY_LEFT_SHIFT);refShift= 0; }
-  Keyboard.releaseAll();
-  pressedCount = 0;
-  digitalWrite(LED_PIN, LOW);
+  if (!pending) return;
+  flushReport();
+#if PERF_PROFILE
+  perf[PERF_REPORT].record(cycleCount() - started);
+#endif
+}
+
+void keyboardIdle() {
+  // Nothing to poll while the matrix sleeps: wait for the next interrupt
+  // (column edge, USB or systick). Checked with interrupts masked so a wake
+  // that lands just before the WFI still ends it.
+  noInterrupts();
+  if (idlePolicy.sleeping() && events.empty()) asm volatile("wfi");
+  interrupts();
+}
+
+void keyboardScanStats(ScanStats &out, bool reset) {
+  noInterrupts();
+  out = scheduler.getStats();
+  if (reset) scheduler.resetStats();
+  interrupts();
+}
+
+uint16_t keyboardSettleTimes(uint32_t (&cycles)[NUM_ROWS], uint32_t &defaultCycles, uint32_t &floorCycles) {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) cycles[r] = rowSettleCycles[r];
+  defaultCycles = SELECT_SETTLE_US * cyclesPerUs();
+  floorCycles = columnRecoveryCycles;
+  return settleDefaultRows;
+}
+
+#if PERF_PROFILE
+void keyboardPerfRecord(PerfStage stage, uint32_t cycles) {
+  perf[stage].record(cycles);
+}
+
+void keyboardPerfStats(PerfStats (&out)[PERF_STAGES], uint32_t &scanBudgetCycles, bool reset) {
+  scanBudgetCycles = SCAN_PERIOD_US * cyclesPerUs();
+  noInterrupts();
+  for (uint8_t i = 0; i < PERF_STAGES; ++i) {
+    out[i] = perf[i].getStats();
+    if (reset) perf[i].reset();
+  }
+  interrupts();
+}
+#endif
+
+const LatencyHistogram &keyboardLatency(LatencyStage stage) {
+  return latency.stage(stage);
+}
+
+void keyboardLatencyReset() {
+  latency.reset();
+}
+
+void keyboardQueueStats(QueueStats &out, uint32_t &replays, bool reset) {
+  noInterrupts();
+  out = events.getStats();
+  replays = keys.replays();
+  if (reset) {
+    events.resetStats();
+    keys.resetReplays();
+  }
+  interrupts();
+}
+
+// The core's descriptor table (usb_desc.c). usb_desc.h only declares it
+// under USB_DESC_LIST_DEFINE, which is private to the core's usb.c, so the
+// entry layout is repeated here; the list ends at an entry with no addr.
+struct CoreDescriptorEntry {
+  uint16_t wValue;
+  uint16_t wIndex;
+  const uint8_t *addr;
+  uint16_t length;
+};
+extern "C" const CoreDescriptorEntry usb_descriptor_list[];
+
+bool keyboardUsbInfo(KeyboardUsbInfo &out) {
+  // The core lists the high-speed configuration as 0x0200 and the
+  // full-speed one as "other speed" (0x0700), and sends whichever matches
+  // the link
+  out.highSpeed = (USB1_PORTSC1 & USB_PORTSC1_HSP) != 0;
+  out.scanRateHz = SCAN_RATE_HZ;
+  out.pollUs = 0;
+  const uint16_t wanted = out.highSpeed ? 0x0200 : 0x0700;
+  for (const CoreDescriptorEntry *d = usb_descriptor_list; d->addr; ++d) {
+    if (d->wValue != wanted) continue;
+    if (!findKeyboardEndpoint(d->addr, d->length, out.endpoint)) return false;
+    out.pollUs = interruptIntervalUs(out.endpoint.bInterval, out.highSpeed);
+    return true;
+  }
+  return false;
+}
+
+#ifdef SOF_ALIGN
+void keyboardSofStats(SofStats &out, int32_t &phaseErrorUs, bool reset) {
+  noInterrupts();
+  out = sofAligner.getStats();
+  phaseErrorUs = sofAligner.phaseError();
+  if (reset) sofAligner.resetStats();
+  interrupts();
+}
+#endif
+
+void keyboardIdleStats(IdleStats &out, bool reset) {
+  noInterrupts();
+  out = idlePolicy.getStats();
+  if (reset) idlePolicy.resetStats();
+  interrupts();
+}
+
+// ================================
+// Runtime keymap and profiles (loop() side)
+//
+// Held keys release with the action they were pressed with, so editing or
+// switching away from a held key cannot leave a key or modifier stuck.
+// ================================
+
+void keyboardKeymapGet(PackedKeymap &out) {
+  out = profiles[activeProfile].keymap;
+}
+
+KeymapSource keyboardKeymapSource() {
+  return profiles[activeProfile].source;
+}
+
+void keyboardKeymapWrite(const PackedKeymap &km) {
+  keymapStoreSave(km);
+  profiles[0].keymap = km;
+  profiles[0].source = KEYMAP_SOURCE_STORED;
+  if (activeProfile == 0) scheduleKeymap(km);
+}
+
+bool keyboardKeymapSet(uint8_t layer, uint8_t row, uint8_t col, PackedAction action) {
+  if (layer >= NUM_LAYERS || row >= NUM_ROWS || col >= NUM_COLS) return false;
+  if (!keymapActionValid(action)) return false;
+  KeymapProfile &p = profiles[activeProfile];
+  p.keymap.actions[layer][row][col] = action;
+  keymapUpdateValidRows(p.keymap);
+  p.source = KEYMAP_SOURCE_EDITED;
+  scheduleKeymap(p.keymap);
+  return true;
+}
+
+void keyboardKeymapSave() {
+  // The saved keymap is what profile 0 loads at the next boot
+  keymapStoreSave(profiles[activeProfile].keymap);
+  if (activeProfile != 0) profiles[0].keymap = profiles[activeProfile].keymap;
+  profiles[0].source = KEYMAP_SOURCE_STORED;
+}
+
+void keyboardKeymapReset() {
+  keymapStoreErase();
+  profiles[0].keymap = defaultKeymap;
+  profiles[0].source = KEYMAP_SOURCE_DEFAULT;
+  if (activeProfile == 0) scheduleKeymap(defaultKeymap);
+}
+
+bool keyboardProfileSelect(uint8_t slot) {
+  if (slot >= KEYMAP_PROFILES || !profiles[slot].name[0]) return false;
+  activeProfile = slot;
+  scheduleKeymap(profiles[slot].keymap);
+  return true;
+}
+
+int8_t keyboardProfileFind(const char *name) {
+  for (uint8_t i = 0; i < KEYMAP_PROFILES; ++i) {
+    if (profiles[i].name[0] && strcmp(profiles[i].name, name) == 0) return (int8_t)i;
+  }
+  return -1;
+}
+
+bool keyboardProfileStore(uint8_t slot, const char *name, const PackedKeymap &km) {
+  if (slot == 0 || slot >= KEYMAP_PROFILES) return false;
+  const size_t len = strlen(name);
+  if (len == 0 || len > PROFILE_NAME_LEN) return false;
+  KeymapProfile &p = profiles[slot];
+  memcpy(p.name, name, len + 1);
+  p.keymap = km;
+  p.source = KEYMAP_SOURCE_EDITED;
+  if (slot == activeProfile) scheduleKeymap(km);
+  return true;
+}
+
+uint8_t keyboardProfileActive() {
+  return activeProfile;
+}
+
+const char *keyboardProfileName(uint8_t slot) {
+  return (slot < KEYMAP_PROFILES && profiles[slot].name[0]) ? profiles[slot].name : nullptr;
 }
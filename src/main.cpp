@@ -9,17 +9,25 @@ void setup() {
     while (!Serial && millis() < 2000) {
    }
   }
-  debugPrint("Booting EvoCmdWingKeyboard...");
+  LOG_SERIAL_INFO("Booting EvoCmdWingKeyboard...");
 
   // Initialize keyboard matrix
   keyboardInit();
 }
 
 void loop() {
-  keyboardScan();
+  // Matrix scanning runs from the scan timer started in keyboardInit()
 
   #if defined(USB_SERIAL) || defined(USB_SERIAL_HID) 
   checkSerialForReboot();
   #endif
+
+  // Key events queued by the scans go out as HID reports here
+  keyboardReport();
+
+  // Debug trace records go out after the reports, never blocking
+  traceDrain();
+
+  keyboardIdle();
   
 }
@@ -1,4 +1,8 @@
 #include "utils.h"
+#include "Keysend.h"
+#include "KeymapImage.h"
+#include "EventQueue.h"
+#include "MatrixIO.h"
 #if defined(USB_SERIAL) || defined(USB_SERIAL_HID) || defined(USB_TRIPLE_SERIAL)
 extern "C" void _reboot_Teensyduino_(void);
 #endif
@@ -43,35 +47,146 @@ void debugPrintf(const char* format, ...) {
 }
 
 
+//================================
+// TRACE
+//================================
+
+// Compiled in with the HID debug log level only; otherwise the ring and
+// its drain go away and LOG_HID_TRACE() call sites emit nothing
+#if LOG_LEVEL_HID >= LOG_LEVEL_DEBUG
+
+// Records waiting to be sent; a full ring drops new records (counted)
+static const uint16_t TRACE_RING_SIZE = 256;
+static SpscQueue<TraceRecord, TRACE_RING_SIZE> traceRing;
+static uint32_t traceDropsReported = 0;
+
+void trace(TraceEvent event, uint8_t row, uint8_t col, uint8_t arg0, uint8_t arg1, uint32_t timeUs) {
+  if (!debugMode) return;
+  traceRing.push(traceRecord(event, row, col, arg0, arg1, timeUs));
+}
+
+void traceDrain() {
+  if (!debugMode) return;
+
+  const uint32_t drops = traceRing.getStats().overflows;
+  if (drops != traceDropsReported && Serial.availableForWrite() >= (int)TRACE_DROPPED_SIZE) {
+    char dropped[TRACE_DROPPED_SIZE];
+    Serial.write(dropped, traceFormatDropped(drops - traceDropsReported, dropped));
+    traceDropsReported = drops;
+  }
+
+  // Only write what fits in the USB buffers right now; the rest waits
+  static char line[TRACE_LINE_SIZE];
+  while (!traceRing.empty() && Serial.availableForWrite() >= (int)sizeof(line)) {
+    Serial.write(line, traceFormatLine(traceRing, line));
+  }
+}
+
+#else
+
+void traceDrain() {}
+
+#endif // LOG_LEVEL_HID
+
 
 
 #if defined(USB_SERIAL) || defined(USB_SERIAL_HID) || defined(USB_TRIPLE_SERIAL)
 //================================
 // UPLOAD Function 
 //================================
-// Upload without pressing button, using python script; polls Serial for commands
-void checkSerialForReboot() {
+// Upload without pressing button, using python script; polls Serial for commands.
+// Returns true with a complete command in cmd
+static bool pollSerialCommands(String &cmd) {
     static String commandBuffer = "";
     
     // Read all available characters and buffer them
     while (Serial.available()) {
         char c = Serial.read();
         if (c == '\n' || c == '\r') {
-            // End of command received, process it
+            // End of command received, hand it back
             commandBuffer.trim(); // Remove any whitespace
-            String cmd = commandBuffer;
+            cmd = commandBuffer;
             commandBuffer = ""; // Clear buffer for next command
-            
-            // Process the complete command
-            if (cmd.length() > 0) {
-                processSerialCommand(cmd);
-            }
-            return;
+            return cmd.length() > 0;
         } else {
             // Add character to buffer
             commandBuffer += c;
         }
     }
+    return false;
+}
+
+void checkSerialForReboot() {
+    static String cmd; // kept so an idle poll constructs nothing
+#if PERF_PROFILE
+    // Every poll counts toward the serial stage, idle or not; the command
+    // it completes is timed separately
+    const uint32_t started = cycleCount();
+    const bool complete = pollSerialCommands(cmd);
+    keyboardPerfRecord(PERF_SERIAL, cycleCount() - started);
+    if (!complete) return;
+    const uint32_t commandStarted = cycleCount();
+    processSerialCommand(cmd);
+    keyboardPerfRecord(PERF_COMMAND, cycleCount() - commandStarted);
+#else
+    if (pollSerialCommands(cmd)) processSerialCommand(cmd);
+#endif
+}
+
+// Hex image -> keymap; anything but KEYMAP_IMAGE_OK leaves km untouched
+static KeymapImageStatus parseHexKeymap(const char *hex, size_t len, PackedKeymap &km) {
+    uint8_t image[KEYMAP_IMAGE_SIZE];
+    if (!hexDecode(hex, len, image, KEYMAP_IMAGE_SIZE)) return KEYMAP_IMAGE_BAD_SIZE;
+    return parseKeymap(image, KEYMAP_IMAGE_SIZE, km);
+}
+
+static void printProfile(uint8_t slot) {
+    Serial.print("[PROFILE] slot=");
+    Serial.print(slot);
+    Serial.print(" name=");
+    Serial.print(keyboardProfileName(slot));
+    Serial.print(" active=");
+    Serial.println(slot == keyboardProfileActive() ? 1 : 0);
+}
+
+// Cycles as microseconds with one decimal
+static void printMicros(uint32_t cycles) {
+    const uint32_t tenths = (uint32_t)((uint64_t)cycles * 10 / cyclesPerUs());
+    Serial.print(tenths / 10);
+    Serial.print('.');
+    Serial.print(tenths % 10);
+}
+
+// BENCH iterations: default, and the most one command may hold the loop
+// for. Every iteration waits out the real row settle times, about 50 us
+// with all rows on the 5 us default, so the cap keeps a scenario near one
+// second and "BENCH all" within a few.
+static const uint32_t BENCH_DEFAULT_ITERATIONS = 10000;
+static const uint32_t BENCH_MAX_ITERATIONS = 20000;
+
+// Runs one scenario and prints its cycles per iteration per stage
+static void runBench(BenchScenario scenario, uint32_t iterations) {
+    static const char *const stages[] = {"matrix", "debounce", "dispatch", "report"};
+    BenchResult r;
+    if (!keyboardBench(scenario, iterations, r)) return;
+    uint64_t total = 0;
+    Serial.print("[BENCH] scenario=");
+    Serial.print(benchScenarioName(scenario));
+    Serial.print(" iterations=");
+    Serial.print(r.iterations);
+    Serial.print(" events=");
+    Serial.print(r.events);
+    Serial.print(" reports=");
+    Serial.print(r.reports);
+    for (uint8_t i = 0; i < BENCH_STAGES; ++i) {
+        total += r.ticks[i];
+        Serial.print(' ');
+        Serial.print(stages[i]);
+        Serial.print('=');
+        Serial.print((uint32_t)(r.ticks[i] / r.iterations));
+    }
+    Serial.print(" total=");
+    Serial.println((uint32_t)(total / r.iterations));
 }
 
 // Send identiy so we can update a specific teensy when more than one is plugged in, used with teensy_auto_upload_multi.py
@@ -107,6 +222,270 @@ void processSerialCommand(String cmd) {
         // Normal restart using ARM AIRCR register
         SCB_AIRCR = 0x05FA0004;
         
+    } else if (cmd == "SCANSTATS") {
+        // Scan period/jitter counters since the last SCANSTATS, queue and
+        // SOF counters, and the settle times calibrated at boot
+        ScanStats st;
+        keyboardScanStats(st, true);
+        Serial.print("[SCAN] ticks=");
+        Serial.print(st.ticks);
+        Serial.print(" fast=");
+        Serial.print(st.fastPath);
+        Serial.print(" late=");
+        Serial.print(st.late);
+        Serial.print(" missed=");
+        Serial.print(st.missed);
+        Serial.print(" max_late_us=");
+        Serial.print(st.maxLateUs);
+        Serial.print(" min_period_us=");
+        Serial.print(st.ticks > 1 ? st.minPeriodUs : 0);
+        Serial.print(" max_period_us=");
+        Serial.println(st.maxPeriodUs);
+
+        // Per-row settle times from boot calibration, in ns
+        uint32_t settle[NUM_ROWS];
+        uint32_t settleDefault;
+        uint32_t settleFloor;
+        const uint16_t defaultRows = keyboardSettleTimes(settle, settleDefault, settleFloor);
+        Serial.print("[SETTLE] default_ns=");
+        Serial.print(settleDefault * 1000 / cyclesPerUs());
+        Serial.print(" floor_ns=");
+        Serial.print(settleFloor * 1000 / cyclesPerUs());
+        Serial.print(" default_rows=0x");
+        Serial.print(defaultRows, HEX);
+        Serial.print(" row_ns=");
+        for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+            if (r) Serial.print(',');
+            Serial.print(settle[r] * 1000 / cyclesPerUs());
+        }
+        Serial.println();
+
+        QueueStats q;
+        uint32_t replays;
+        keyboardQueueStats(q, replays, true);
+        Serial.print("[QUEUE] pushed=");
+        Serial.print(q.pushed);
+        Serial.print(" overflows=");
+        Serial.print(q.overflows);
+        Serial.print(" high_water=");
+        Serial.print(q.highWater);
+        Serial.print(" replays=");
+        Serial.println(replays);
+
+#ifdef SOF_ALIGN
+        SofStats sof;
+        int32_t phaseErr;
+        keyboardSofStats(sof, phaseErr, true);
+        Serial.print("[SOF] sofs=");
+        Serial.print(sof.sofs);
+        Serial.print(" locked=");
+        Serial.print(sof.lockedScans);
+        Serial.print(" lost=");
+        Serial.print(sof.lostScans);
+        Serial.print(" max_err_us=");
+        Serial.print(sof.maxErrorUs);
+        Serial.print(" phase_err_us=");
+        Serial.println((long)phaseErr);
+#endif
+
+        IdleStats idle;
+        keyboardIdleStats(idle, true);
+        Serial.print("[IDLE] entries=");
+        Serial.print(idle.entries);
+        Serial.print(" wakes=");
+        Serial.print(idle.wakes);
+        Serial.print(" missed_edges=");
+        Serial.print(idle.missedEdges);
+        Serial.print(" max_wake_us=");
+        Serial.println(idle.maxWakeUs);
+
+    } else if (cmd == "STATS") {
+        // Key latency per stage since the last STATS (p50/p99 are bucket tops)
+        static const char *const stages[] = {"debounce", "report", "total"};
+        for (uint8_t i = 0; i < LATENCY_STAGES; ++i) {
+            const LatencyHistogram &h = keyboardLatency((LatencyStage)i);
+            Serial.print("[LATENCY] stage=");
+            Serial.print(stages[i]);
+            Serial.print(" n=");
+            Serial.print(h.count());
+            Serial.print(" p50_us=");
+            printMicros(h.percentile(50));
+            Serial.print(" p99_us=");
+            printMicros(h.percentile(99));
+            Serial.print(" max_us=");
+            printMicros(h.max());
+            Serial.println();
+        }
+        keyboardLatencyReset();
+
+    } else if (cmd == "PERF") {
+        // Cycles per stage since the last PERF; scan stages are per-scan sums
+        // and the budget is one scan period. This PERF shows up under
+        // command in the next one
+#if PERF_PROFILE
+        static const char *const stages[] = {"select", "read", "debounce", "dispatch", "scan", "report", "serial", "command"};
+        PerfStats st[PERF_STAGES];
+        uint32_t budget;
+        keyboardPerfStats(st, budget, true);
+        Serial.print("[PERF] cpu_mhz=");
+        Serial.print(cyclesPerUs());
+        Serial.print(" budget_cycles=");
+        Serial.println(budget);
+        for (uint8_t i = 0; i < PERF_STAGES; ++i) {
+            Serial.print("[PERF] stage=");
+            Serial.print(stages[i]);
+            Serial.print(" samples=");
+            Serial.print(st[i].samples);
+            Serial.print(" min=");
+            Serial.print(st[i].minCycles);
+            Serial.print(" mean=");
+            Serial.print(st[i].samples ? (uint32_t)(st[i].totalCycles / st[i].samples) : 0);
+            Serial.print(" max=");
+            Serial.print(st[i].maxCycles);
+            Serial.print(" total=");
+            Serial.println(st[i].totalCycles);
+        }
+#else
+        Serial.println("[PERF] disabled");
+#endif
+
+    } else if (cmd == "BENCH" || cmd.startsWith("BENCH ")) {
+        // BENCH [scenario|all] [iterations]: scanning stops while it runs;
+        // results are CPU cycles per iteration
+        char name[12] = "all";
+        unsigned long iterations = BENCH_DEFAULT_ITERATIONS;
+        sscanf(cmd.c_str(), "BENCH %11s %lu", name, &iterations);
+        if (iterations == 0 || iterations > BENCH_MAX_ITERATIONS) iterations = BENCH_DEFAULT_ITERATIONS;
+
+        int8_t only = -1;
+        for (uint8_t i = 0; i < BENCH_SCENARIOS; ++i) {
+            if (strcmp(name, benchScenarioName((BenchScenario)i)) == 0) only = (int8_t)i;
+        }
+        if (only < 0 && strcmp(name, "all") != 0) {
+            Serial.print("[BENCH] error unknown=");
+            Serial.println(name);
+        } else {
+            Serial.print("[BENCH] cpu_mhz=");
+            Serial.println(cyclesPerUs());
+            for (uint8_t i = 0; i < BENCH_SCENARIOS; ++i) {
+                if (only < 0 || only == i) runBench((BenchScenario)i, (uint32_t)iterations);
+            }
+        }
+
+    } else if (cmd == "USBINFO") {
+        // Keyboard endpoint polling as the host sees it
+        KeyboardUsbInfo info;
+        const bool found = keyboardUsbInfo(info);
+        Serial.print("[USB] speed=");
+        Serial.print(info.highSpeed ? "high" : "full");
+        if (found) {
+            Serial.print(" interface=");
+            Serial.print(info.endpoint.interfaceNumber);
+            Serial.print(" endpoint=0x");
+            Serial.print(info.endpoint.endpointAddress, HEX);
+            Serial.print(" max_packet=");
+            Serial.print(info.endpoint.maxPacket);
+            Serial.print(" bInterval=");
+            Serial.print(info.endpoint.bInterval);
+            Serial.print(" poll_us=");
+            Serial.print(info.pollUs);
+        } else {
+            Serial.print(" keyboard=none");
+        }
+        Serial.print(" scan_hz=");
+        Serial.println(info.scanRateHz);
+
+    } else if (cmd == "KEYMAP_DUMP") {
+        // Active profile as a hex image (same format as the EEPROM copy)
+        static const char *const sources[] = {"default", "stored", "edited"};
+        PackedKeymap km;
+        keyboardKeymapGet(km);
+        uint8_t image[KEYMAP_IMAGE_SIZE];
+        serializeKeymap(km, image);
+        Serial.print("[KEYMAP] source=");
+        Serial.print(sources[keyboardKeymapSource()]);
+        Serial.print(" size=");
+        Serial.println((unsigned)KEYMAP_IMAGE_SIZE);
+        Serial.print("[KEYMAP] image=");
+        char hex[2 * 32 + 1];
+        for (size_t i = 0; i < KEYMAP_IMAGE_SIZE; i += 32) {
+            const size_t n = (KEYMAP_IMAGE_SIZE - i < 32) ? KEYMAP_IMAGE_SIZE - i : 32;
+            hexEncode(image + i, n, hex);
+            Serial.print(hex);
+        }
+        Serial.println();
+
+    } else if (cmd.startsWith("KEYMAP_WRITE ")) {
+        // KEYMAP_WRITE <hex image>: validate, store in EEPROM as the boot keymap
+        const String hex = cmd.substring(13);
+        PackedKeymap km;
+        const KeymapImageStatus status = parseHexKeymap(hex.c_str(), hex.length(), km);
+        if (status == KEYMAP_IMAGE_OK) {
+            keyboardKeymapWrite(km);
+            Serial.println("[KEYMAP] write=ok");
+        } else {
+            Serial.print("[KEYMAP] write=error status=");
+            Serial.println((unsigned)status);
+        }
+
+    } else if (cmd.startsWith("KEYMAP_SET ")) {
+        // KEYMAP_SET <layer> <row> <col> <action hex>: active profile, RAM only until KEYMAP_SAVE
+        unsigned layer, row, col, action;
+        if (sscanf(cmd.c_str(), "KEYMAP_SET %u %u %u %x", &layer, &row, &col, &action) == 4 &&
+            action <= 0xFFFF &&
+            keyboardKeymapSet((uint8_t)layer, (uint8_t)row, (uint8_t)col, (PackedAction)action)) {
+            Serial.println("[KEYMAP] set=ok");
+        } else {
+            Serial.println("[KEYMAP] set=error");
+        }
+
+    } else if (cmd == "KEYMAP_SAVE") {
+        keyboardKeymapSave();
+        Serial.println("[KEYMAP] save=ok");
+
+    } else if (cmd == "KEYMAP_RESET") {
+        // Back to the compiled-in keymap; the stored image is invalidated
+        keyboardKeymapReset();
+        Serial.println("[KEYMAP] reset=ok");
+
+    } else if (cmd == "PROFILE") {
+        // List the loaded profiles
+        for (uint8_t i = 0; i < KEYMAP_PROFILES; ++i) {
+            if (keyboardProfileName(i)) printProfile(i);
+        }
+
+    } else if (cmd.startsWith("PROFILE ")) {
+        // PROFILE <name|slot>: switch at the next scan boundary
+        const String arg = cmd.substring(8);
+        int8_t slot = keyboardProfileFind(arg.c_str());
+        if (slot < 0 && arg.length() == 1 && arg[0] >= '0' && arg[0] <= '9') slot = (int8_t)(arg[0] - '0');
+        if (slot >= 0 && keyboardProfileSelect((uint8_t)slot)) {
+            printProfile((uint8_t)slot);
+        } else {
+            Serial.print("[PROFILE] error unknown=");
+            Serial.println(arg);
+        }
+
+    } else if (cmd.startsWith("PROFILE_STORE ") || cmd.startsWith("PROFILE_WRITE ")) {
+        // PROFILE_STORE <slot> <name>: copy of the active profile
+        // PROFILE_WRITE <slot> <name> <hex image>: load an image into RAM
+        unsigned slot;
+        char name[PROFILE_NAME_LEN + 2];
+        int hexAt = 0;
+        bool ok = sscanf(cmd.c_str() + 14, "%u %16s %n", &slot, name, &hexAt) >= 2 && slot < 256;
+        PackedKeymap km;
+        if (ok && cmd.startsWith("PROFILE_WRITE ")) {
+            const char *hex = cmd.c_str() + 14 + hexAt;
+            ok = hexAt > 0 && parseHexKeymap(hex, strlen(hex), km) == KEYMAP_IMAGE_OK;
+        } else if (ok) {
+            keyboardKeymapGet(km);
+        }
+        if (ok && keyboardProfileStore((uint8_t)slot, name, km)) {
+            printProfile((uint8_t)slot);
+        } else {
+            Serial.println("[PROFILE] error");
+        }
+
     } else {
         Serial.print("[REBOOT] Unknown command: ");
         Serial.println(cmd);
@@ -0,0 +1,141 @@
+// test_main.cpp: scan benchmark on the host, with simulated ports
+#include <chrono>
+#include <stdio.h>
+#include <unity.h>
+#include "Debounce.h"
+#include "Bench.h"
+
+static const uint32_t DEBOUNCE_MS = 5;
+static const uint32_t SCAN_PERIOD_US = 1000;
+static const uint16_t QUEUE_SIZE = 64;
+
+typedef TimestampDebouncer<DEBOUNCE_MS> Debouncer;
+
+static ScanBench<Debouncer, QUEUE_SIZE> bench;
+static ResolvedKeymap resolved;
+static uint32_t settle[NUM_ROWS];
+
+// Nanoseconds, truncated to the free-running count the bench expects
+static uint32_t hostClock() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Every position a Ctrl chord with its own usage, from 0x04 in row-major
+// order; layers above 0 empty
+static void chordKeymap() {
+  static PackedKeymap km;
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        km.actions[l][r][c] = l ? ACTION_NONE : (PackedAction)((0x04 + r * NUM_COLS + c) | (MOD_LCTRL << 8));
+      }
+    }
+  }
+  keymapUpdateValidRows(km);
+  resolveKeymap(km, resolved);
+}
+
+// Keys in the boot report's slots; keys past six get none
+static uint16_t keysDown(const ReportBuilder &b) {
+  uint16_t n = 0;
+  for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) n += b.report().keys[i] != 0;
+  return n;
+}
+
+void setUp() {
+  chordKeymap();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = 4;
+}
+
+void tearDown() {}
+
+// ================================
+// Tests
+// ================================
+
+void test_idle_sends_nothing() {
+  BenchResult out;
+  bench.run(BENCH_IDLE, 1000, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+  TEST_ASSERT_EQUAL_UINT32(1000, out.iterations);
+  TEST_ASSERT_EQUAL_UINT32(0, out.events);
+  TEST_ASSERT_EQUAL_UINT32(0, out.reports);
+  TEST_ASSERT_EQUAL_UINT16(0, keysDown(bench.report()));
+}
+
+// Two holds and two releases: one event and one report for each
+void test_one_key_presses_and_releases() {
+  BenchResult out;
+  bench.run(BENCH_ONE_KEY, 4 * BENCH_HOLD_ITERATIONS, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+  TEST_ASSERT_EQUAL_UINT32(4, out.events);
+  TEST_ASSERT_EQUAL_UINT32(4, out.reports);
+  TEST_ASSERT_EQUAL_UINT16(0, keysDown(bench.report()));
+}
+
+// Ten Ctrl chords held together keep one Ctrl down (six of them get a
+// slot), and releasing them all clears it; the chords go through the
+// firmware's reporter
+void test_ten_chords_share_modifier() {
+  BenchResult out;
+  bench.run(BENCH_TEN_KEYS, BENCH_HOLD_ITERATIONS, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+  TEST_ASSERT_EQUAL_UINT32(10, out.events);
+  TEST_ASSERT_EQUAL_UINT32(1, out.reports);
+  TEST_ASSERT_EQUAL_UINT16(HID_KEY_SLOTS, keysDown(bench.report()));
+  TEST_ASSERT_EQUAL_HEX8(HID_MOD_LCTRL, bench.report().report().mods);
+
+  bench.run(BENCH_TEN_KEYS, 2 * BENCH_HOLD_ITERATIONS, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+  TEST_ASSERT_EQUAL_UINT32(20, out.events);
+  TEST_ASSERT_EQUAL_UINT32(2, out.reports);
+  TEST_ASSERT_EQUAL_UINT16(0, keysDown(bench.report()));
+  TEST_ASSERT_EQUAL_HEX8(0, bench.report().report().mods);
+}
+
+// Events the queue turned away are not counted. Ten presses into an
+// 8-slot queue: eight land, and the replay never finds room for eleven.
+void test_dropped_events_not_counted() {
+  static ScanBench<Debouncer, 8> small;
+  BenchResult out;
+  small.run(BENCH_TEN_KEYS, BENCH_HOLD_ITERATIONS, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+  TEST_ASSERT_EQUAL_UINT32(8, out.events);
+  TEST_ASSERT_EQUAL_UINT16(HID_KEY_SLOTS, keysDown(small.report()));
+}
+
+// Same inputs on every run
+void test_runs_repeat() {
+  BenchResult a;
+  BenchResult b;
+  bench.run(BENCH_CHATTER, 2000, SCAN_PERIOD_US, resolved, settle, hostClock, a);
+  bench.run(BENCH_CHATTER, 2000, SCAN_PERIOD_US, resolved, settle, hostClock, b);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, a.events);
+  TEST_ASSERT_EQUAL_UINT32(a.events, b.events);
+  TEST_ASSERT_EQUAL_UINT32(a.reports, b.reports);
+}
+
+// Host timings of every scenario, nanoseconds per iteration. Only for
+// comparing changes on one machine; the target numbers come from BENCH.
+void test_report_timings() {
+  static const char *const stages[] = {"matrix", "debounce", "dispatch", "report"};
+  for (uint8_t s = 0; s < BENCH_SCENARIOS; ++s) {
+    BenchResult out;
+    bench.run((BenchScenario)s, 20000, SCAN_PERIOD_US, resolved, settle, hostClock, out);
+    char msg[160];
+    int len = snprintf(msg, sizeof(msg), "%s: events=%u reports=%u ns/iteration",
+                       benchScenarioName((BenchScenario)s), (unsigned)out.events, (unsigned)out.reports);
+    for (uint8_t st = 0; st < BENCH_STAGES && len > 0 && (size_t)len < sizeof(msg); ++st) {
+      len += snprintf(msg + len, sizeof(msg) - (size_t)len, " %s=%u", stages[st],
+                      (unsigned)(out.ticks[st] / out.iterations));
+    }
+    TEST_MESSAGE(msg);
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_idle_sends_nothing);
+  RUN_TEST(test_one_key_presses_and_releases);
+  RUN_TEST(test_ten_chords_share_modifier);
+  RUN_TEST(test_dropped_events_not_counted);
+  RUN_TEST(test_runs_repeat);
+  RUN_TEST(test_report_timings);
+  return UNITY_END();
+}
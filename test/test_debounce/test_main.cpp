@@ -0,0 +1,317 @@
+// test_main.cpp: debounce engines fed with key traces
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <unity.h>
+#include "Debounce.h"
+
+// ================================
+// Traces
+//
+// One character per 1 ms scan of a single key, '1' = contact closed, as the
+// default 1 kHz scan samples a key that bounces for a few milliseconds on
+// each edge.
+// ================================
+
+static const char *const CLEAN_TAP       = "000011111111111111110000000000000";
+static const char *const BOUNCY_PRESS    = "000010110111111111111111111111111";
+static const char *const BOUNCY_RELEASE  = "111111111111111111010010000000000";
+static const char *const BOUNCY_TAP      = "000101101111111111111111010100000000000000";
+static const char *const SINGLE_GLITCH   = "000100000000000000000";
+
+static const uint8_t TEST_ROW = 3;
+static const uint8_t TEST_COL = 5;
+static const uint16_t TEST_BIT = 1u << TEST_COL;
+
+struct Edge {
+  uint32_t at;   // sample index
+  bool pressed;
+};
+
+struct Events {
+  Edge edges[16];
+  uint8_t count;
+};
+
+// Runs one key's trace through an engine, one sample per millisecond
+template <class Debouncer>
+static Events runTrace(Debouncer &d, const char *trace) {
+  Events ev = {};
+  d.reset();
+  for (uint32_t i = 0; trace[i]; ++i) {
+    const uint16_t raw = (trace[i] == '1') ? TEST_BIT : 0;
+    const uint16_t flipped = d.update(TEST_ROW, raw, i);
+    if (flipped & TEST_BIT) {
+      TEST_ASSERT_TRUE(ev.count < 16);
+      ev.edges[ev.count++] = {i, (d.state(TEST_ROW) & TEST_BIT) != 0};
+    }
+    TEST_ASSERT_EQUAL_HEX16(0, flipped & (uint16_t)~TEST_BIT);
+  }
+  return ev;
+}
+
+static uint32_t firstContact(const char *trace) {
+  return (uint32_t)(strchr(trace, '1') - trace);
+}
+
+// Last sample where the trace changed level
+static uint32_t lastChange(const char *trace) {
+  uint32_t last = 0;
+  for (uint32_t i = 1; trace[i]; ++i) {
+    if (trace[i] != trace[i - 1]) last = i;
+  }
+  return last;
+}
+
+static const uint32_t DEBOUNCE_MS = 5;
+
+typedef TimestampDebouncer<DEBOUNCE_MS> DeferDebouncer;
+typedef TimestampDebouncer<DEBOUNCE_MS, DEBOUNCE_EAGER, DEBOUNCE_DEFER> EagerPressDebouncer;
+typedef TimestampDebouncer<DEBOUNCE_MS, DEBOUNCE_DEFER, DEBOUNCE_EAGER> EagerReleaseDebouncer;
+typedef TimestampDebouncer<DEBOUNCE_MS, DEBOUNCE_EAGER, DEBOUNCE_EAGER> EagerDebouncer;
+typedef VerticalCounterDebouncer<DEBOUNCE_MS> VerticalDebouncer;
+
+void setUp() {}
+void tearDown() {}
+
+// ================================
+// Timestamp engine policies
+// ================================
+
+void test_defer_press_waits_out_bounces() {
+  DeferDebouncer d;
+  const Events ev = runTrace(d, BOUNCY_PRESS);
+  TEST_ASSERT_EQUAL_UINT8(1, ev.count);
+  TEST_ASSERT_TRUE(ev.edges[0].pressed);
+  TEST_ASSERT_EQUAL_UINT32(lastChange(BOUNCY_PRESS) + DEBOUNCE_MS, ev.edges[0].at);
+}
+
+void test_eager_press_reports_first_contact() {
+  EagerPressDebouncer d;
+  const Events ev = runTrace(d, BOUNCY_PRESS);
+  TEST_ASSERT_EQUAL_UINT8(1, ev.count);
+  TEST_ASSERT_TRUE(ev.edges[0].pressed);
+  TEST_ASSERT_EQUAL_UINT32(firstContact(BOUNCY_PRESS), ev.edges[0].at);
+}
+
+// Press-to-report latency over each press trace, in scans
+void test_eager_press_latency() {
+  static const char *const traces[] = {CLEAN_TAP, BOUNCY_PRESS, BOUNCY_TAP};
+  DeferDebouncer defer;
+  EagerPressDebouncer eager;
+  for (const char *trace : traces) {
+    const uint32_t contact = firstContact(trace);
+    const Events d = runTrace(defer, trace);
+    const Events e = runTrace(eager, trace);
+    TEST_ASSERT_TRUE(d.count >= 1 && e.count >= 1);
+    TEST_ASSERT_EQUAL_UINT32(0, e.edges[0].at - contact);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(DEBOUNCE_MS, d.edges[0].at - contact);
+  }
+}
+
+void test_eager_release_reports_first_break() {
+  EagerReleaseDebouncer d;
+  d.reset();
+  // Start held: the first pressed samples commit a press before the trace
+  for (uint32_t i = 0; i <= DEBOUNCE_MS; ++i) d.update(TEST_ROW, TEST_BIT, i);
+  TEST_ASSERT_EQUAL_HEX16(TEST_BIT, d.state(TEST_ROW));
+
+  const uint32_t t0 = 100;
+  const uint32_t firstBreak = (uint32_t)(strchr(BOUNCY_RELEASE, '0') - BOUNCY_RELEASE);
+  uint8_t events = 0;
+  for (uint32_t i = 0; BOUNCY_RELEASE[i]; ++i) {
+    const uint16_t flipped = d.update(TEST_ROW, BOUNCY_RELEASE[i] == '1' ? TEST_BIT : 0, t0 + i);
+    if (flipped) {
+      ++events;
+      TEST_ASSERT_EQUAL_UINT32(firstBreak, i);
+      TEST_ASSERT_EQUAL_HEX16(0, d.state(TEST_ROW));
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT8(1, events);
+}
+
+// Every change inside the lockout is ignored: one event per edge
+void test_eager_tap_emits_one_press_and_release() {
+  EagerDebouncer d;
+  const Events ev = runTrace(d, BOUNCY_TAP);
+  TEST_ASSERT_EQUAL_UINT8(2, ev.count);
+  TEST_ASSERT_TRUE(ev.edges[0].pressed);
+  TEST_ASSERT_FALSE(ev.edges[1].pressed);
+  TEST_ASSERT_EQUAL_UINT32(firstContact(BOUNCY_TAP), ev.edges[0].at);
+  // First break once the press lockout is over
+  const char *held = BOUNCY_TAP + firstContact(BOUNCY_TAP) + DEBOUNCE_MS;
+  TEST_ASSERT_EQUAL_UINT32((uint32_t)(strchr(held, '0') - BOUNCY_TAP), ev.edges[1].at);
+}
+
+// The trade-off of eager presses: a lone glitch becomes a short tap, with
+// the release held back until the lockout has passed
+void test_eager_press_glitch_becomes_tap() {
+  DeferDebouncer defer;
+  TEST_ASSERT_EQUAL_UINT8(0, runTrace(defer, SINGLE_GLITCH).count);
+
+  EagerPressDebouncer eager;
+  const Events ev = runTrace(eager, SINGLE_GLITCH);
+  const uint32_t glitch = firstContact(SINGLE_GLITCH);
+  TEST_ASSERT_EQUAL_UINT8(2, ev.count);
+  TEST_ASSERT_EQUAL_UINT32(glitch, ev.edges[0].at);
+  TEST_ASSERT_EQUAL_UINT32(glitch + 1 + DEBOUNCE_MS, ev.edges[1].at);
+}
+
+// A release inside the eager lockout commits when the window ends
+void test_eager_lockout_delays_early_release() {
+  EagerDebouncer d;
+  const Events ev = runTrace(d, "0011000000000000");
+  TEST_ASSERT_EQUAL_UINT8(2, ev.count);
+  TEST_ASSERT_EQUAL_UINT32(2, ev.edges[0].at);
+  TEST_ASSERT_EQUAL_UINT32(2 + DEBOUNCE_MS, ev.edges[1].at);
+}
+
+// ================================
+// Vertical counter
+// ================================
+
+void test_counter_bits() {
+  TEST_ASSERT_EQUAL_UINT8(1, counterBits(1));
+  TEST_ASSERT_EQUAL_UINT8(2, counterBits(2));
+  TEST_ASSERT_EQUAL_UINT8(2, counterBits(3));
+  TEST_ASSERT_EQUAL_UINT8(3, counterBits(5));
+  TEST_ASSERT_EQUAL_UINT8(8, counterBits(255));
+}
+
+void test_vertical_flips_on_last_sample() {
+  VerticalDebouncer d;
+  d.reset();
+  for (uint8_t i = 1; i < DEBOUNCE_MS; ++i) {
+    TEST_ASSERT_EQUAL_HEX16(0, d.update(0, 0x0001, i));
+  }
+  TEST_ASSERT_EQUAL_HEX16(0x0001, d.update(0, 0x0001, DEBOUNCE_MS));
+  TEST_ASSERT_EQUAL_HEX16(0x0001, d.state(0));
+  TEST_ASSERT_EQUAL_HEX16(0, d.update(0, 0x0001, DEBOUNCE_MS + 1));
+}
+
+void test_vertical_chatter_never_commits() {
+  VerticalDebouncer d;
+  d.reset();
+  for (uint32_t i = 0; i < 100; ++i) {
+    TEST_ASSERT_EQUAL_HEX16(0, d.update(0, (i & 1) ? COL_MASK : 0, i));
+  }
+  TEST_ASSERT_EQUAL_HEX16(0, d.state(0));
+}
+
+// Every column starts one sample after the previous one, all in one row word
+void test_vertical_keys_count_independently() {
+  VerticalDebouncer d;
+  d.reset();
+  uint16_t raw = 0;
+  for (uint8_t i = 0; i < NUM_COLS + DEBOUNCE_MS; ++i) {
+    if (i < NUM_COLS) raw |= (uint16_t)(1u << i);
+    const uint16_t flipped = d.update(7, raw, i);
+    const int committed = i - (int)DEBOUNCE_MS + 1;
+    TEST_ASSERT_EQUAL_HEX16((committed >= 0 && committed < NUM_COLS) ? (1u << committed) : 0, flipped);
+  }
+  TEST_ASSERT_EQUAL_HEX16(COL_MASK, d.state(7));
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    if (r != 7) TEST_ASSERT_EQUAL_HEX16(0, d.state(r));
+  }
+}
+
+void test_vertical_clear() {
+  VerticalDebouncer d;
+  d.reset();
+  for (uint32_t i = 0; i < DEBOUNCE_MS; ++i) d.update(2, 0x0100, i);
+  TEST_ASSERT_EQUAL_HEX16(0x0100, d.state(2));
+  d.clear(2);
+  TEST_ASSERT_EQUAL_HEX16(0, d.state(2));
+}
+
+void test_vertical_idle() {
+  VerticalDebouncer d;
+  d.reset();
+  TEST_ASSERT_TRUE(d.idle());
+  d.update(2, 0x0100, 0);
+  TEST_ASSERT_FALSE(d.idle()); // counting
+  d.update(2, 0, 1);
+  TEST_ASSERT_TRUE(d.idle());  // counter reset by agreement
+
+  for (uint32_t i = 0; i < DEBOUNCE_MS; ++i) d.update(2, 0x0100, i);
+  TEST_ASSERT_FALSE(d.idle()); // held
+  d.clear(2);
+  TEST_ASSERT_TRUE(d.idle());
+}
+
+// Both engines must see the same press/release sequence on every trace.
+// The vertical counter commits on the DEBOUNCE_MS-th differing sample, the
+// timestamp engine once DEBOUNCE_MS have passed since the last change, so
+// the counter is at most one sample earlier.
+void test_engines_agree_on_traces() {
+  static const char *const traces[] = {CLEAN_TAP, BOUNCY_PRESS, BOUNCY_RELEASE, BOUNCY_TAP, SINGLE_GLITCH};
+  DeferDebouncer stamp;
+  VerticalDebouncer vertical;
+  for (const char *trace : traces) {
+    const Events a = runTrace(stamp, trace);
+    const Events b = runTrace(vertical, trace);
+    TEST_ASSERT_EQUAL_UINT8(a.count, b.count);
+    for (uint8_t i = 0; i < a.count; ++i) {
+      TEST_ASSERT_EQUAL(a.edges[i].pressed, b.edges[i].pressed);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(a.edges[i].at, b.edges[i].at);
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(a.edges[i].at - 1, b.edges[i].at);
+    }
+  }
+}
+
+// Whole-matrix chatter: per-scan cost of both engines on the same samples.
+// Timings are informational; the engines must end in the same state.
+template <class Debouncer>
+static double nsPerScan(Debouncer &d, uint32_t scans, uint16_t (&finalState)[NUM_ROWS]) {
+  d.reset();
+  uint32_t x = 0x2545F491u;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < scans; ++i) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      // Each key bounces for the first 3 ms of every 64 ms, then holds
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      const bool settled = (i & 63) >= 3;
+      const uint16_t level = ((i >> 6) & 1) ? COL_MASK : 0;
+      d.update(r, settled ? level : (uint16_t)(x & COL_MASK), i);
+    }
+  }
+  const auto end = std::chrono::steady_clock::now();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) finalState[r] = d.state(r);
+  return std::chrono::duration<double, std::nano>(end - start).count() / scans;
+}
+
+void test_engine_cost_on_chatter() {
+  static DeferDebouncer stamp;
+  static VerticalDebouncer vertical;
+  uint16_t a[NUM_ROWS], b[NUM_ROWS];
+  const uint32_t scans = 64 * 200 + 40;
+  const double stampNs = nsPerScan(stamp, scans, a);
+  const double verticalNs = nsPerScan(vertical, scans, b);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(a, b, NUM_ROWS);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "per scan: timestamp %.0f ns, vertical %.0f ns", stampNs, verticalNs);
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_defer_press_waits_out_bounces);
+  RUN_TEST(test_eager_press_reports_first_contact);
+  RUN_TEST(test_eager_press_latency);
+  RUN_TEST(test_eager_release_reports_first_break);
+  RUN_TEST(test_eager_tap_emits_one_press_and_release);
+  RUN_TEST(test_eager_press_glitch_becomes_tap);
+  RUN_TEST(test_eager_lockout_delays_early_release);
+  RUN_TEST(test_counter_bits);
+  RUN_TEST(test_vertical_flips_on_last_sample);
+  RUN_TEST(test_vertical_chatter_never_commits);
+  RUN_TEST(test_vertical_keys_count_independently);
+  RUN_TEST(test_vertical_clear);
+  RUN_TEST(test_vertical_idle);
+  RUN_TEST(test_engines_agree_on_traces);
+  RUN_TEST(test_engine_cost_on_chatter);
+  return UNITY_END();
+}
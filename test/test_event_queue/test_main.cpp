@@ -0,0 +1,283 @@
+// test_main.cpp: SpscQueue and the scan-side replay under a slow consumer
+#include <stdio.h>
+#include <algorithm>
+#include <thread>
+#include <unity.h>
+#include "KeyDispatch.h"
+#include "KeyReporter.h"
+
+void setUp() {}
+void tearDown() {}
+
+// xorshift32: repeatable key churn
+static uint32_t nextRandom(uint32_t &x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+// ================================
+// Ring
+// ================================
+
+void test_fifo_across_index_wrap() {
+  static SpscQueue<uint32_t, 8> q;
+  uint32_t next = 0;
+  uint32_t expect = 0;
+  // Well past the 16-bit index wrap, at varying fill levels
+  for (uint32_t i = 0; i < 70000; ++i) {
+    const uint32_t burst = i % 8 + 1;
+    for (uint32_t k = 0; k < burst; ++k) TEST_ASSERT_TRUE(q.push(next++));
+    uint32_t v;
+    for (uint32_t k = 0; k < burst; ++k) {
+      TEST_ASSERT_TRUE(q.pop(v));
+      TEST_ASSERT_EQUAL_UINT32(expect++, v);
+    }
+    TEST_ASSERT_TRUE(q.empty());
+  }
+  TEST_ASSERT_EQUAL_UINT32(next, q.getStats().pushed);
+  TEST_ASSERT_EQUAL_UINT32(0, q.getStats().overflows);
+  TEST_ASSERT_EQUAL_UINT16(8, q.getStats().highWater);
+}
+
+void test_full_ring_drops_and_counts() {
+  SpscQueue<uint32_t, 4> q;
+  TEST_ASSERT_EQUAL_UINT16(4, q.freeSlots());
+  for (uint32_t i = 0; i < 4; ++i) TEST_ASSERT_TRUE(q.push(i));
+  TEST_ASSERT_EQUAL_UINT16(0, q.freeSlots());
+  TEST_ASSERT_FALSE(q.push(99));
+  TEST_ASSERT_FALSE(q.push(99));
+
+  // The queued items are intact; the dropped ones never show up
+  uint32_t v;
+  for (uint32_t i = 0; i < 4; ++i) {
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+  TEST_ASSERT_FALSE(q.pop(v));
+
+  const QueueStats &s = q.getStats();
+  TEST_ASSERT_EQUAL_UINT32(4, s.pushed);
+  TEST_ASSERT_EQUAL_UINT32(2, s.overflows);
+  TEST_ASSERT_EQUAL_UINT16(4, s.highWater);
+  q.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, q.getStats().pushed);
+  TEST_ASSERT_EQUAL_UINT16(0, q.getStats().highWater);
+}
+
+// Producer and consumer on two threads. First the producer waits for room,
+// so every item must arrive, in order; then it pushes regardless, and
+// whatever arrives arrives in order while the rest is counted as dropped.
+void test_two_threads() {
+  static SpscQueue<uint32_t, 64> q;
+  static const uint32_t LOSSLESS = 100000;
+  static const uint32_t ITEMS = 200000;
+  static const uint32_t DONE = 0xFFFFFFFFu;
+
+  std::thread producer([] {
+    for (uint32_t i = 0; i < LOSSLESS; ++i) {
+      while (!q.freeSlots()) std::this_thread::yield();
+      q.push(i);
+    }
+    for (uint32_t i = LOSSLESS; i < ITEMS; ++i) q.push(i);
+    while (!q.freeSlots()) std::this_thread::yield();
+    q.push(DONE);
+  });
+
+  uint32_t received = 0;
+  uint32_t last = 0;
+  bool ordered = true;
+  for (;;) {
+    uint32_t v;
+    if (!q.pop(v)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (v == DONE) break;
+    if (v < LOSSLESS ? v != received : v <= last) ordered = false;
+    last = v;
+    ++received;
+  }
+  producer.join();
+
+  const QueueStats &s = q.getStats();
+  TEST_ASSERT_TRUE(ordered);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(LOSSLESS, received);
+  TEST_ASSERT_EQUAL_UINT32(ITEMS, received + s.overflows);
+  TEST_ASSERT_EQUAL_UINT32(received + 1, s.pushed);
+  TEST_ASSERT_TRUE(s.highWater <= 64);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "two threads: %u delivered, %u dropped, high water %u",
+           (unsigned)received, (unsigned)s.overflows, (unsigned)s.highWater);
+  TEST_MESSAGE(msg);
+}
+
+// ================================
+// Slow USB consumer
+//
+// Scans press and release random keys every tick; the reporter only gets
+// to drain a few events now and then, as if the endpoint were busy. Events
+// get dropped, and the replay must bring the report back to exactly the
+// keys still held.
+// ================================
+
+static const uint16_t SMALL_QUEUE = 16;
+
+// Every position a distinct plain key
+static void allKeysKeymap(ResolvedKeymap &out) {
+  static PackedKeymap km;
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) {
+        km.actions[l][r][c] = l ? ACTION_NONE : (PackedAction)(0x04 + r * NUM_COLS + c);
+      }
+    }
+  }
+  keymapUpdateValidRows(km);
+  resolveKeymap(km, out);
+}
+
+// Report keys sorted, so the slot order does not matter
+static void sortedKeys(const KeyboardReport &rep, uint8_t (&out)[HID_KEY_SLOTS]) {
+  for (uint8_t i = 0; i < HID_KEY_SLOTS; ++i) out[i] = rep.keys[i];
+  std::sort(out, out + HID_KEY_SLOTS);
+}
+
+// Boot report keys of the keys the dispatcher holds
+template <uint16_t N>
+static void expectedReport(const KeyDispatcher<N> &keys, uint8_t (&out)[HID_KEY_SLOTS]) {
+  ReportBuilder b;
+  b.clear();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    for (uint8_t c = 0; c < NUM_COLS; ++c) {
+      const PackedAction a = keys.heldAction(r, c);
+      if (a != ACTION_NONE) b.pressKey(actionUsage(a));
+    }
+  }
+  KeyboardReport rep = {};
+  b.takeChanged(rep);
+  sortedKeys(rep, out);
+}
+
+void test_slow_consumer_recovers_by_replay() {
+  static ResolvedKeymap km;
+  allKeysKeymap(km);
+  static SpscQueue<KeyEvent, SMALL_QUEUE> q;
+  static KeyDispatcher<SMALL_QUEUE> keys(q);
+  keys.begin(km);
+  KeyReporter reporter;
+  reporter.reset();
+
+  bool down[NUM_ROWS][NUM_COLS] = {};
+  uint8_t held = 0;
+  uint32_t seed = 0xC0FFEEu;
+  for (uint32_t scan = 0; scan < 50000; ++scan) {
+    keys.beginScan();
+
+    // Up to 6 changes per scan, never more than 6 keys down (the boot
+    // report's slots; the replay needs room for RESET plus every held key)
+    const uint32_t changes = nextRandom(seed) % 7;
+    for (uint32_t k = 0; k < changes; ++k) {
+      const uint32_t pos = nextRandom(seed) % (NUM_ROWS * NUM_COLS);
+      const uint8_t r = (uint8_t)(pos / NUM_COLS);
+      const uint8_t c = (uint8_t)(pos % NUM_COLS);
+      if (down[r][c]) {
+        keys.release(r, c, 0);
+        down[r][c] = false;
+        --held;
+      } else if (held < HID_KEY_SLOTS) {
+        keys.press(r, c, 0);
+        down[r][c] = true;
+        ++held;
+      }
+    }
+
+    // The busy endpoint: one scan in four drains up to three events
+    if (nextRandom(seed) % 4 == 0) {
+      KeyEvent ev;
+      for (uint32_t n = nextRandom(seed) % 4; n && q.pop(ev); --n) reporter.apply(ev);
+    }
+  }
+
+  // USB catches up; scans keep running with no key changes
+  for (uint32_t scan = 0; scan < 4; ++scan) {
+    KeyEvent ev;
+    while (q.pop(ev)) reporter.apply(ev);
+    keys.beginScan();
+  }
+  KeyEvent ev;
+  while (q.pop(ev)) reporter.apply(ev);
+
+  uint8_t expected[HID_KEY_SLOTS];
+  uint8_t actual[HID_KEY_SLOTS];
+  expectedReport(keys, expected);
+  KeyboardReport rep = {};
+  reporter.takeChanged(rep);
+  sortedKeys(rep, actual);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, HID_KEY_SLOTS);
+
+  const QueueStats &s = q.getStats();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, s.overflows);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, keys.replays());
+  TEST_ASSERT_EQUAL_UINT16(SMALL_QUEUE, s.highWater);
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "slow consumer: %u queued, %u dropped, %u replays",
+           (unsigned)s.pushed, (unsigned)s.overflows, (unsigned)keys.replays());
+  TEST_MESSAGE(msg);
+}
+
+// A replay waits until the queue has room for all of it
+void test_replay_waits_for_room() {
+  static ResolvedKeymap km;
+  allKeysKeymap(km);
+  static SpscQueue<KeyEvent, SMALL_QUEUE> q;
+  static KeyDispatcher<SMALL_QUEUE> keys(q);
+  keys.begin(km);
+
+  // 20 presses into 16 slots: the 17th is dropped, and the rest are left
+  // to the replay rather than queued behind the gap
+  keys.beginScan();
+  for (uint8_t c = 0; c < 10; ++c) {
+    keys.press(0, c, 0);
+    keys.press(1, c, 0);
+  }
+  TEST_ASSERT_EQUAL_UINT32(16, q.getStats().pushed);
+  TEST_ASSERT_EQUAL_UINT32(1, q.getStats().overflows);
+
+  // 4 slots free: not enough for RESET plus 20 presses
+  KeyEvent ev;
+  for (uint8_t i = 0; i < 4; ++i) q.pop(ev);
+  TEST_ASSERT_TRUE(keys.beginScan());
+  TEST_ASSERT_EQUAL_UINT32(0, keys.replays());
+
+  // Releases while the replay is pending are covered by it
+  for (uint8_t c = 0; c < 10; ++c) keys.release(1, c, 0);
+  TEST_ASSERT_EQUAL_UINT16(4, q.freeSlots());
+  while (q.pop(ev)) {}
+
+  // RESET plus the 10 keys still held
+  TEST_ASSERT_TRUE(keys.beginScan());
+  TEST_ASSERT_EQUAL_UINT32(1, keys.replays());
+  TEST_ASSERT_TRUE(q.pop(ev));
+  TEST_ASSERT_EQUAL_UINT8(KEY_EVENT_RESET, ev.type);
+  for (uint8_t c = 0; c < 10; ++c) {
+    TEST_ASSERT_TRUE(q.pop(ev));
+    TEST_ASSERT_EQUAL_UINT8(KEY_EVENT_PRESS, ev.type);
+    TEST_ASSERT_EQUAL_UINT8(c, ev.pos);
+  }
+  TEST_ASSERT_FALSE(q.pop(ev));
+  TEST_ASSERT_FALSE(keys.beginScan());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_across_index_wrap);
+  RUN_TEST(test_full_ring_drops_and_counts);
+  RUN_TEST(test_two_threads);
+  RUN_TEST(test_slow_consumer_recovers_by_replay);
+  RUN_TEST(test_replay_waits_for_room);
+  return UNITY_END();
+}
@@ -0,0 +1,170 @@
+// test_main.cpp: KeyReporter report sequences for keys, modifiers and chords
+#include <unity.h>
+#include "KeyReporter.h"
+
+static const PackedAction KEY_A = packAction(KA_base('a'));
+static const PackedAction KEY_EXCLAIM = packAction(KA_base('!'));
+static const PackedAction CTRL_C = packAction(KA_chord('c', MOD_LCTRL));
+static const PackedAction CTRL_V = packAction(KA_chord('v', MOD_LCTRL));
+static const PackedAction CTRL_ALT_T = packAction(KA_chord('t', (ModMask)(MOD_LCTRL | MOD_LALT)));
+static const PackedAction LSHIFT = packAction(KA_mod(MOD_LSHIFT));
+static const PackedAction FN = packAction(KA_momentary(LAYER_FN));
+
+static const uint8_t USAGE_A = 0x04;
+static const uint8_t USAGE_C = 0x06;
+static const uint8_t USAGE_T = 0x17;
+static const uint8_t USAGE_V = 0x19;
+static const uint8_t USAGE_1 = 0x1E;
+
+static KeyReporter reporter;
+
+// Reports sent so far; one scan's events go out as at most one report
+static const uint8_t MAX_REPORTS = 16;
+static KeyboardReport sent[MAX_REPORTS];
+static uint8_t sentCount;
+
+void setUp() {
+  reporter = KeyReporter();
+  sentCount = 0;
+}
+
+void tearDown() {}
+
+// ================================
+// Helpers
+// ================================
+
+static KeyEvent event(KeyEventType type, PackedAction a) { return {0, 0, 0, a, 0, (uint8_t)type}; }
+static KeyEvent press(PackedAction a) { return event(KEY_EVENT_PRESS, a); }
+static KeyEvent release(PackedAction a) { return event(KEY_EVENT_RELEASE, a); }
+static KeyEvent reset() { return event(KEY_EVENT_RESET, ACTION_NONE); }
+
+// One scan: apply its events, then take the report as flushReport() does
+template <size_t N>
+static void scan(const KeyEvent (&events)[N]) {
+  for (const KeyEvent &ev : events) reporter.apply(ev);
+  KeyboardReport rep;
+  if (reporter.takeChanged(rep)) {
+    TEST_ASSERT_TRUE(sentCount < MAX_REPORTS);
+    sent[sentCount++] = rep;
+  }
+}
+
+static void scanNothing() {
+  KeyboardReport rep;
+  if (reporter.takeChanged(rep)) sent[sentCount++] = rep;
+}
+
+static void assertReport(uint8_t index, uint8_t mods, uint8_t key0, uint8_t key1 = 0) {
+  TEST_ASSERT_TRUE(index < sentCount);
+  const KeyboardReport &r = sent[index];
+  TEST_ASSERT_EQUAL_HEX8(mods, r.mods);
+  TEST_ASSERT_EQUAL_HEX8(key0, r.keys[0]);
+  TEST_ASSERT_EQUAL_HEX8(key1, r.keys[1]);
+  for (uint8_t i = 2; i < HID_KEY_SLOTS; ++i) TEST_ASSERT_EQUAL_HEX8(0, r.keys[i]);
+}
+
+// ================================
+// Chords
+// ================================
+
+// The old path sent Ctrl, then Ctrl+C; now the chord is one report each way
+void test_chord_is_one_report_each_way() {
+  scan({press(CTRL_C)});
+  scan({release(CTRL_C)});
+  TEST_ASSERT_EQUAL_UINT8(2, sentCount);
+  assertReport(0, HID_MOD_LCTRL, USAGE_C);
+  assertReport(1, 0, 0);
+}
+
+void test_two_modifier_chord() {
+  scan({press(CTRL_ALT_T)});
+  scan({release(CTRL_ALT_T)});
+  TEST_ASSERT_EQUAL_UINT8(2, sentCount);
+  assertReport(0, HID_MOD_LCTRL | HID_MOD_LALT, USAGE_T);
+  assertReport(1, 0, 0);
+}
+
+// Shifted characters carry Shift in the action
+void test_shifted_character() {
+  scan({press(KEY_EXCLAIM)});
+  scan({release(KEY_EXCLAIM)});
+  TEST_ASSERT_EQUAL_UINT8(2, sentCount);
+  assertReport(0, HID_MOD_LSHIFT, USAGE_1);
+  assertReport(1, 0, 0);
+}
+
+// Two chords sharing Ctrl: Ctrl stays down until the last one is released
+void test_shared_modifier_refcount() {
+  scan({press(CTRL_C)});
+  scan({press(CTRL_V)});
+  scan({release(CTRL_C)});
+  scan({release(CTRL_V)});
+  TEST_ASSERT_EQUAL_UINT8(4, sentCount);
+  assertReport(0, HID_MOD_LCTRL, USAGE_C);
+  assertReport(1, HID_MOD_LCTRL, USAGE_C, USAGE_V);
+  assertReport(2, HID_MOD_LCTRL, 0, USAGE_V);
+  assertReport(3, 0, 0);
+}
+
+// A physical Shift held across a shifted character keeps Shift down
+void test_physical_modifier_outlives_chord() {
+  scan({press(LSHIFT)});
+  scan({press(KEY_EXCLAIM)});
+  scan({release(KEY_EXCLAIM)});
+  scan({release(LSHIFT)});
+  TEST_ASSERT_EQUAL_UINT8(4, sentCount);
+  assertReport(0, HID_MOD_LSHIFT, 0);
+  assertReport(1, HID_MOD_LSHIFT, USAGE_1);
+  assertReport(2, HID_MOD_LSHIFT, 0);
+  assertReport(3, 0, 0);
+}
+
+// ================================
+// Coalescing
+// ================================
+
+// Several changes in one scan go out together
+void test_same_scan_changes_coalesce() {
+  scan({press(KEY_A), press(CTRL_C), press(LSHIFT)});
+  TEST_ASSERT_EQUAL_UINT8(1, sentCount);
+  assertReport(0, HID_MOD_LCTRL | HID_MOD_LSHIFT, USAGE_A, USAGE_C);
+}
+
+// Nothing is sent when the report did not change
+void test_unchanged_report_not_sent() {
+  scan({press(KEY_A)});
+  scanNothing();
+  scan({press(CTRL_C), release(CTRL_C)});  // a press and release in one scan
+  scan({press(FN)});                       // layer keys never reach the report
+  scan({release(FN)});
+  TEST_ASSERT_EQUAL_UINT8(1, sentCount);
+  assertReport(0, 0, USAGE_A);
+}
+
+// A reset (release all, queue resync) forgets the refcounts too: a chord
+// pressed afterwards clears its modifier on release
+void test_reset_clears_refcounts() {
+  scan({press(CTRL_C), press(CTRL_V)});
+  scan({reset()});
+  scan({press(CTRL_C)});
+  scan({release(CTRL_C)});
+  TEST_ASSERT_EQUAL_UINT8(4, sentCount);
+  assertReport(0, HID_MOD_LCTRL, USAGE_C, USAGE_V);
+  assertReport(1, 0, 0);
+  assertReport(2, HID_MOD_LCTRL, USAGE_C);
+  assertReport(3, 0, 0);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_chord_is_one_report_each_way);
+  RUN_TEST(test_two_modifier_chord);
+  RUN_TEST(test_shifted_character);
+  RUN_TEST(test_shared_modifier_refcount);
+  RUN_TEST(test_physical_modifier_outlives_chord);
+  RUN_TEST(test_same_scan_changes_coalesce);
+  RUN_TEST(test_unchanged_report_not_sent);
+  RUN_TEST(test_reset_clears_refcounts);
+  return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// test_main.cpp: IdlePolicy driven with simulated time and column edges
+#include <unity.h>
+#include "IdlePolicy.h"
+
+static const uint32_t QUIET_US = 250000;
+static const uint32_t SCAN_US = 1000;
+
+static IdlePolicy idle;
+
+void setUp() {
+  idle = IdlePolicy();
+}
+
+void tearDown() {}
+
+// Scans with no activity until the policy asks to sleep; returns that time
+static uint32_t scanUntilIdle(uint32_t now) {
+  for (uint32_t i = 0; i < 2 * QUIET_US / SCAN_US; ++i, now += SCAN_US) {
+    idle.onScan(false, now);
+    if (idle.shouldEnterIdle(now)) return now;
+  }
+  TEST_FAIL_MESSAGE("never asked to enter idle");
+  return now;
+}
+
+void test_disabled_never_sleeps() {
+  idle.begin(0, 0);
+  for (uint32_t now = 0; now < 4 * QUIET_US; now += SCAN_US) {
+    idle.onScan(false, now);
+    TEST_ASSERT_FALSE(idle.shouldEnterIdle(now));
+  }
+}
+
+void test_enters_after_quiet_period() {
+  idle.begin(QUIET_US, 0);
+  TEST_ASSERT_EQUAL_UINT32(QUIET_US, scanUntilIdle(SCAN_US));
+  TEST_ASSERT_TRUE(idle.enterIdle(false, QUIET_US));
+  TEST_ASSERT_EQUAL(IDLE_SLEEPING, idle.getState());
+  TEST_ASSERT_TRUE(idle.sleeping());
+  TEST_ASSERT_EQUAL_UINT32(1, idle.getStats().entries);
+}
+
+void test_activity_restarts_quiet_period() {
+  idle.begin(QUIET_US, 0);
+  idle.onScan(true, 200000);
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(QUIET_US));
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(200000 + QUIET_US - 1));
+  TEST_ASSERT_TRUE(idle.shouldEnterIdle(200000 + QUIET_US));
+}
+
+// A column already LOW after arming: abort, count it, wait a full quiet
+// period before trying again
+void test_missed_edge_aborts_entry() {
+  idle.begin(QUIET_US, 0);
+  const uint32_t t = scanUntilIdle(SCAN_US);
+  TEST_ASSERT_FALSE(idle.enterIdle(true, t));
+  TEST_ASSERT_EQUAL(IDLE_SCANNING, idle.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, idle.getStats().missedEdges);
+  TEST_ASSERT_EQUAL_UINT32(0, idle.getStats().entries);
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(t + SCAN_US));
+  TEST_ASSERT_EQUAL_UINT32(t + QUIET_US, scanUntilIdle(t + SCAN_US));
+}
+
+void test_wake_edge_and_first_scan() {
+  idle.begin(QUIET_US, 0);
+  const uint32_t t = scanUntilIdle(SCAN_US);
+  idle.enterIdle(false, t);
+
+  const uint32_t edge = t + 5000000;
+  TEST_ASSERT_TRUE(idle.onWakeEdge(edge));
+  TEST_ASSERT_EQUAL(IDLE_WAKING, idle.getState());
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(edge + QUIET_US));
+
+  // First scan after the edge: latency recorded, counts as activity
+  idle.onScan(false, edge + 7);
+  TEST_ASSERT_EQUAL(IDLE_SCANNING, idle.getState());
+  TEST_ASSERT_EQUAL_UINT32(1, idle.getStats().wakes);
+  TEST_ASSERT_EQUAL_UINT32(7, idle.getStats().maxWakeUs);
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(edge + 7 + QUIET_US - 1));
+  TEST_ASSERT_TRUE(idle.shouldEnterIdle(edge + 7 + QUIET_US));
+}
+
+// Edges while scanning (e.g. the IRQ firing late) change nothing
+void test_edge_while_scanning_ignored() {
+  idle.begin(QUIET_US, 0);
+  TEST_ASSERT_FALSE(idle.onWakeEdge(100));
+  TEST_ASSERT_EQUAL(IDLE_SCANNING, idle.getState());
+  TEST_ASSERT_EQUAL_UINT32(0, idle.getStats().wakes);
+
+  const uint32_t t = scanUntilIdle(SCAN_US);
+  idle.enterIdle(false, t);
+  TEST_ASSERT_TRUE(idle.onWakeEdge(t + 10));
+  TEST_ASSERT_FALSE(idle.onWakeEdge(t + 11)); // second column of the same press
+  TEST_ASSERT_EQUAL_UINT32(1, idle.getStats().wakes);
+}
+
+void test_resume_without_edge() {
+  idle.begin(QUIET_US, 0);
+  const uint32_t t = scanUntilIdle(SCAN_US);
+  idle.enterIdle(false, t);
+  idle.resume(t + 100);
+  TEST_ASSERT_EQUAL(IDLE_SCANNING, idle.getState());
+  TEST_ASSERT_FALSE(idle.shouldEnterIdle(t + 100 + QUIET_US - 1));
+  TEST_ASSERT_EQUAL_UINT32(0, idle.getStats().wakes);
+}
+
+void test_quiet_period_across_wraparound() {
+  const uint32_t t0 = 0xFFFFFFFFu - 100000;
+  idle.begin(QUIET_US, t0);
+  TEST_ASSERT_EQUAL_UINT32(t0 + QUIET_US, scanUntilIdle(t0 + SCAN_US));
+}
+
+// Several sleep/wake cycles: the worst edge-to-scan latency is kept
+void test_wake_latency_is_worst_case() {
+  static const uint32_t latencies[] = {12, 40, 3, 25};
+  idle.begin(QUIET_US, 0);
+  uint32_t t = SCAN_US;
+  for (uint32_t lat : latencies) {
+    t = scanUntilIdle(t);
+    TEST_ASSERT_TRUE(idle.enterIdle(false, t));
+    t += 1000000;
+    TEST_ASSERT_TRUE(idle.onWakeEdge(t));
+    idle.onScan(false, t + lat);
+    t += lat + SCAN_US;
+  }
+  const IdleStats &s = idle.getStats();
+  TEST_ASSERT_EQUAL_UINT32(4, s.entries);
+  TEST_ASSERT_EQUAL_UINT32(4, s.wakes);
+  TEST_ASSERT_EQUAL_UINT32(40, s.maxWakeUs);
+
+  idle.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, idle.getStats().maxWakeUs);
+  TEST_ASSERT_EQUAL_UINT32(0, idle.getStats().entries);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_disabled_never_sleeps);
+  RUN_TEST(test_enters_after_quiet_period);
+  RUN_TEST(test_activity_restarts_quiet_period);
+  RUN_TEST(test_missed_edge_aborts_entry);
+  RUN_TEST(test_wake_edge_and_first_scan);
+  RUN_TEST(test_edge_while_scanning_ignored);
+  RUN_TEST(test_resume_without_edge);
+  RUN_TEST(test_quiet_period_across_wraparound);
+  RUN_TEST(test_wake_latency_is_worst_case);
+  return UNITY_END();
+}
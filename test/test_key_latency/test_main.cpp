@@ -0,0 +1,171 @@
+// test_main.cpp: edge stamps through dispatch into the latency histograms
+#include <unity.h>
+#include "Debounce.h"
+#include "KeyDispatch.h"
+#include "KeyLatency.h"
+
+static const uint16_t QUEUE = 16;
+static const uint32_t DEBOUNCE = 5;            // ms
+static const uint32_t CYCLES_PER_MS = 600000;  // 600 MHz
+static const uint32_t EXPIRY = 4 * DEBOUNCE * CYCLES_PER_MS;
+
+static ResolvedKeymap km;
+static SpscQueue<KeyEvent, QUEUE> q;
+static KeyDispatcher<QUEUE> keys(q);
+static TimestampDebouncer<DEBOUNCE> debouncer;
+static EdgeStamps edges;
+static KeyLatency latency;
+
+// One plain key at (0, 0), one layer key at (0, 1)
+static void buildKeymap() {
+  static PackedKeymap pk;
+  for (uint8_t l = 0; l < NUM_LAYERS; ++l) {
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+      for (uint8_t c = 0; c < NUM_COLS; ++c) pk.actions[l][r][c] = ACTION_NONE;
+    }
+  }
+  pk.actions[0][0][0] = 0x04;  // A
+  pk.actions[0][0][1] = (PackedAction)(ACTION_LAYER | 1);
+  keymapUpdateValidRows(pk);
+  resolveKeymap(pk, km);
+}
+
+// Row 0 read at readAt (cycles), the scan's stamp -> debounce -> dispatch
+// order as in processRow()
+static void scanRow0(uint16_t raw, uint32_t nowMs, uint32_t readAt) {
+  keys.beginScan();
+  edges.stamp(0, raw ^ debouncer.state(0), readAt, EXPIRY);
+  const uint16_t flipped = debouncer.update(0, raw, nowMs);
+  const uint16_t state = debouncer.state(0);
+  edges.commit(0, flipped);
+  for (uint16_t f = flipped; f; f &= (uint16_t)(f - 1)) {
+    const uint8_t c = (uint8_t)__builtin_ctz(f);
+    if (state & (1u << c)) keys.press(0, c, edges.at(0, c));
+    else keys.release(0, c, edges.at(0, c));
+  }
+}
+
+static uint32_t inStageBucket(LatencyStage s, uint32_t v) {
+  return latency.stage(s).bucketCount(LatencyHistogram::bucketOf(v));
+}
+
+void setUp() {
+  simGpio() = SimGpio();
+  buildKeymap();
+  keys.begin(km);
+  KeyEvent ev;
+  while (q.pop(ev)) {
+  }
+  debouncer.reset();
+  edges.clearAll();
+  latency.discard();
+  latency.reset();
+}
+
+void tearDown() {}
+
+// ================================
+// Edge stamp -> KeyEvent
+// ================================
+
+// The stamp is the first read that differed, kept through chatter, and it
+// is what the dispatcher puts on the event
+void test_edge_stamp_reaches_event() {
+  const uint32_t first = 1000000;
+  scanRow0(0x0001, 1, first);
+  scanRow0(0x0000, 2, first + CYCLES_PER_MS);      // bounce
+  scanRow0(0x0001, 3, first + 2 * CYCLES_PER_MS);  // contact again
+  TEST_ASSERT_TRUE(q.empty());
+  scanRow0(0x0001, 3 + DEBOUNCE, first + (2 + DEBOUNCE) * CYCLES_PER_MS);
+
+  KeyEvent ev;
+  TEST_ASSERT_TRUE(q.pop(ev));
+  TEST_ASSERT_EQUAL_UINT8(KEY_EVENT_PRESS, ev.type);
+  TEST_ASSERT_EQUAL_UINT8(0, ev.pos);
+  TEST_ASSERT_EQUAL_UINT32(first, ev.edge);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, ev.cycles);
+  TEST_ASSERT_FALSE(q.pop(ev));
+
+  // The release gets a stamp of its own
+  const uint32_t up = first + 50 * CYCLES_PER_MS;
+  scanRow0(0x0000, 50, up);
+  scanRow0(0x0000, 50 + DEBOUNCE, up + DEBOUNCE * CYCLES_PER_MS);
+  TEST_ASSERT_TRUE(q.pop(ev));
+  TEST_ASSERT_EQUAL_UINT8(KEY_EVENT_RELEASE, ev.type);
+  TEST_ASSERT_EQUAL_UINT32(up, ev.edge);
+}
+
+// A glitch that never committed does not lend its stamp to a later press
+void test_stale_stamp_expires() {
+  const uint32_t glitch = 2000000;
+  edges.stamp(0, 0x0001, glitch, EXPIRY);
+  const uint32_t later = glitch + EXPIRY + 1;
+  edges.stamp(0, 0x0001, later, EXPIRY);
+  TEST_ASSERT_EQUAL_UINT32(later, edges.at(0, 0));
+
+  // Within the expiry the first stamp holds
+  edges.stamp(0, 0x0001, later + EXPIRY, EXPIRY);
+  TEST_ASSERT_EQUAL_UINT32(later, edges.at(0, 0));
+}
+
+// ================================
+// KeyEvent -> histogram buckets
+// ================================
+
+// Each stage's sample lands in the bucket of its own interval
+void test_latency_lands_in_bucket() {
+  const uint32_t edge = 3000000;
+  keys.beginScan();
+  keys.press(0, 0, edge);
+  KeyEvent ev;
+  TEST_ASSERT_TRUE(q.pop(ev));
+  TEST_ASSERT_EQUAL_UINT32(edge, ev.edge);
+
+  // Stand in for the scan's commit time, then hand the report over later
+  const uint32_t debounceCycles = DEBOUNCE * CYCLES_PER_MS;
+  const uint32_t reportCycles = 45000;
+  ev.cycles = edge + debounceCycles;
+  latency.note(ev);
+  TEST_ASSERT_EQUAL_UINT8(1, latency.pending());
+  latency.sent(ev.cycles + reportCycles);
+  TEST_ASSERT_EQUAL_UINT8(0, latency.pending());
+
+  TEST_ASSERT_EQUAL_UINT32(1, latency.stage(LATENCY_DEBOUNCE).count());
+  TEST_ASSERT_EQUAL_UINT32(1, inStageBucket(LATENCY_DEBOUNCE, debounceCycles));
+  TEST_ASSERT_EQUAL_UINT32(1, inStageBucket(LATENCY_REPORT, reportCycles));
+  TEST_ASSERT_EQUAL_UINT32(1, inStageBucket(LATENCY_TOTAL, debounceCycles + reportCycles));
+  TEST_ASSERT_EQUAL_UINT32(debounceCycles + reportCycles, latency.stage(LATENCY_TOTAL).max());
+}
+
+// Replays, resets, layer keys and unstamped events are not timed, and a
+// report that did not go out records nothing
+void test_untimed_events() {
+  KeyEvent ev = {5000, 0, 0, 0x04, 0, KEY_EVENT_PRESS};
+  latency.note(ev);  // no edge stamp (replay)
+  ev = {5000, 1000, 0, ACTION_NONE, 0, KEY_EVENT_RESET};
+  latency.note(ev);
+  ev = {5000, 1000, 0, (PackedAction)(ACTION_LAYER | 1), 1, KEY_EVENT_PRESS};
+  latency.note(ev);
+  TEST_ASSERT_EQUAL_UINT8(0, latency.pending());
+
+  ev = {5000, 1000, 0, 0x04, 0, KEY_EVENT_PRESS};
+  latency.note(ev);
+  latency.discard();
+  latency.sent(9000);
+  TEST_ASSERT_EQUAL_UINT32(0, latency.stage(LATENCY_TOTAL).count());
+
+  // Past the batch size the extra events go unrecorded
+  for (uint8_t i = 0; i < KeyLatency::BATCH + 4; ++i) latency.note(ev);
+  latency.sent(9000);
+  TEST_ASSERT_EQUAL_UINT32(KeyLatency::BATCH, latency.stage(LATENCY_TOTAL).count());
+  TEST_ASSERT_EQUAL_UINT32(KeyLatency::BATCH, inStageBucket(LATENCY_TOTAL, 8000));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_edge_stamp_reaches_event);
+  RUN_TEST(test_stale_stamp_expires);
+  RUN_TEST(test_latency_lands_in_bucket);
+  RUN_TEST(test_untimed_events);
+  return UNITY_END();
+}
@@ -0,0 +1,182 @@
+// test_main.cpp: keymap image serializer, parser and hex transport
+#include <string.h>
+#include <unity.h>
+#include "KeymapImage.h"
+
+static PackedKeymap source;
+static PackedKeymap out;
+static uint8_t image[KEYMAP_IMAGE_SIZE];
+
+// A keymap using every kind of action: keys, chords, a modifier and each
+// layer op
+static void sampleKeymap(PackedKeymap &km) {
+  memset(&km, 0, sizeof(km));
+  km.actions[0][0][0] = packAction(KA_base('a'));
+  km.actions[0][0][1] = packAction(KA_chord('c', MOD_LCTRL));
+  km.actions[0][3][7] = packAction(KA_mod(MOD_LSHIFT));
+  km.actions[0][9][13] = packAction(KA_momentary(LAYER_FN));
+  km.actions[0][9][12] = packAction(KA_toggle(LAYER_FN));
+  km.actions[0][9][11] = packAction(KA_oneshot(LAYER_FN));
+  km.actions[1][1][5] = 0x0042;
+  keymapUpdateValidRows(km);
+}
+
+// Recognizable contents, to show a failed parse left the keymap alone
+static void fillMarker(PackedKeymap &km) {
+  memset(&km, 0xA5, sizeof(km));
+}
+
+static void expectUntouched(const PackedKeymap &km) {
+  PackedKeymap marker;
+  fillMarker(marker);
+  TEST_ASSERT_EQUAL_MEMORY(&marker, &km, sizeof(km));
+}
+
+// Rewrites the trailing CRC after a test edits the image
+static void resealImage() {
+  putLE32(image + KEYMAP_IMAGE_SIZE - 4, crc32(image, KEYMAP_IMAGE_SIZE - 4));
+}
+
+// Offset of an action in the image
+static size_t actionOffset(uint8_t l, uint8_t r, uint8_t c) {
+  return KEYMAP_IMAGE_HEADER + 2 * (((size_t)l * NUM_ROWS + r) * NUM_COLS + c);
+}
+
+void setUp() {
+  sampleKeymap(source);
+  serializeKeymap(source, image);
+  fillMarker(out);
+}
+
+void tearDown() {}
+
+// ================================
+// Tests
+// ================================
+
+void test_crc32_check_value() {
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926u, crc32((const uint8_t *)"123456789", 9));
+  TEST_ASSERT_EQUAL_HEX32(0, crc32(nullptr, 0));
+}
+
+void test_round_trip() {
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_OK, parseKeymap(image, sizeof(image), out));
+  TEST_ASSERT_EQUAL_MEMORY(&source, &out, sizeof(out));
+
+  // Header fields land where the format says
+  TEST_ASSERT_EQUAL_HEX32(KEYMAP_IMAGE_MAGIC, getLE32(image));
+  TEST_ASSERT_EQUAL_UINT8(KEYMAP_IMAGE_VERSION, image[4]);
+  TEST_ASSERT_EQUAL_HEX16(packAction(KA_chord('c', MOD_LCTRL)), getLE16(image + actionOffset(0, 0, 1)));
+  TEST_ASSERT_EQUAL_HEX16(0x0042, getLE16(image + actionOffset(1, 1, 5)));
+}
+
+// The valid masks come from the image, not from whatever out held
+void test_parse_rebuilds_valid_masks() {
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_OK, parseKeymap(image, sizeof(image), out));
+  TEST_ASSERT_EQUAL_HEX16(0x0003, out.validRows[0]);
+  TEST_ASSERT_EQUAL_HEX16(0x0020, out.validRows[1]);
+  TEST_ASSERT_EQUAL_HEX16(0x0080, out.validRows[3]);
+  TEST_ASSERT_EQUAL_HEX16(0x3800, out.validRows[9]);
+  TEST_ASSERT_EQUAL_HEX16(0, out.validRows[5]);
+}
+
+void test_bad_size() {
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_SIZE, parseKeymap(image, sizeof(image) - 1, out));
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_SIZE, parseKeymap(image, 0, out));
+  expectUntouched(out);
+}
+
+// Erased EEPROM reads as 0xFF; keymapStoreErase() breaks the first byte
+void test_bad_magic() {
+  image[0] = 0xFF;
+  resealImage();
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_MAGIC, parseKeymap(image, sizeof(image), out));
+  memset(image, 0xFF, sizeof(image));
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_MAGIC, parseKeymap(image, sizeof(image), out));
+  expectUntouched(out);
+}
+
+void test_bad_version() {
+  image[4] = KEYMAP_IMAGE_VERSION + 1;
+  resealImage();
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_VERSION, parseKeymap(image, sizeof(image), out));
+  expectUntouched(out);
+}
+
+void test_bad_geometry() {
+  image[7] = NUM_COLS + 1;
+  resealImage();
+  TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_GEOMETRY, parseKeymap(image, sizeof(image), out));
+  expectUntouched(out);
+}
+
+// One flipped bit anywhere, the CRC included, fails the check
+void test_bad_crc() {
+  static const size_t offsets[] = {8, actionOffset(1, 1, 5), KEYMAP_IMAGE_SIZE - 5, KEYMAP_IMAGE_SIZE - 1};
+  for (size_t off : offsets) {
+    serializeKeymap(source, image);
+    image[off] ^= 0x10;
+    TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_CRC, parseKeymap(image, sizeof(image), out));
+  }
+  expectUntouched(out);
+}
+
+// Actions this firmware cannot perform are rejected even with a good CRC
+void test_bad_actions() {
+  static const PackedAction bad[] = {
+    (PackedAction)(ACTION_LAYER | (LAYER_OP_MOMENTARY << 12) | 0),           // base layer target
+    (PackedAction)(ACTION_LAYER | (LAYER_OP_MOMENTARY << 12) | NUM_LAYERS),  // no such layer
+    (PackedAction)(ACTION_LAYER | 1),                                        // no layer op
+    (PackedAction)(0x0800 | 0x04),                                           // stray bit
+  };
+  for (PackedAction a : bad) {
+    serializeKeymap(source, image);
+    putLE16(image + actionOffset(0, 4, 4), a);
+    resealImage();
+    TEST_ASSERT_EQUAL(KEYMAP_IMAGE_BAD_ACTION, parseKeymap(image, sizeof(image), out));
+  }
+  expectUntouched(out);
+  TEST_ASSERT_TRUE(keymapActionsValid(source));
+}
+
+void test_hex_round_trip() {
+  char hex[2 * KEYMAP_IMAGE_SIZE + 1];
+  hexEncode(image, sizeof(image), hex);
+  TEST_ASSERT_EQUAL_UINT32(2 * KEYMAP_IMAGE_SIZE, strlen(hex));
+  TEST_ASSERT_EQUAL_MEMORY("454B4D50", hex, 8);
+
+  uint8_t decoded[KEYMAP_IMAGE_SIZE];
+  TEST_ASSERT_TRUE(hexDecode(hex, strlen(hex), decoded, sizeof(decoded)));
+  TEST_ASSERT_EQUAL_MEMORY(image, decoded, sizeof(image));
+
+  const uint8_t bytes[] = {0x00, 0xAB, 0xCD, 0xEF};
+  uint8_t lower[4];
+  TEST_ASSERT_TRUE(hexDecode("00abcdef", 8, lower, sizeof(lower)));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(bytes, lower, 4);
+}
+
+void test_hex_rejects_bad_input() {
+  uint8_t outBytes[2];
+  TEST_ASSERT_FALSE(hexDecode("ABC", 3, outBytes, 2));     // odd length
+  TEST_ASSERT_FALSE(hexDecode("ABCDEF", 6, outBytes, 2));  // too long
+  TEST_ASSERT_FALSE(hexDecode("AB", 2, outBytes, 2));      // too short
+  TEST_ASSERT_FALSE(hexDecode("ABCG", 4, outBytes, 2));    // not a hex digit
+  TEST_ASSERT_FALSE(hexDecode("AB C", 4, outBytes, 2));
+  TEST_ASSERT_FALSE(hexDecode("0x12", 4, outBytes, 2));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_crc32_check_value);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_parse_rebuilds_valid_masks);
+  RUN_TEST(test_bad_size);
+  RUN_TEST(test_bad_magic);
+  RUN_TEST(test_bad_version);
+  RUN_TEST(test_bad_geometry);
+  RUN_TEST(test_bad_crc);
+  RUN_TEST(test_bad_actions);
+  RUN_TEST(test_hex_round_trip);
+  RUN_TEST(test_hex_rejects_bad_input);
+  return UNITY_END();
+}
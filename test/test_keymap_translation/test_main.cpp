@@ -0,0 +1,197 @@
+// test_main.cpp: compile-time keymap translation against the core's US layout
+#include <stdio.h>
+#include <unity.h>
+#include "Keymap.h"
+
+// ================================
+// Runtime reference
+//
+// The Teensy core's US English layout (keylayouts.h, ASCII_20-ASCII_7E):
+// a usage plus SHIFT_MASK for characters typed with Shift. At runtime
+// Keyboard.press(ch) looks the character up here, presses Shift if the
+// mask is set and then the key (keycode & 0x3F).
+// ================================
+
+static const uint8_t SHIFT_MASK = 0x40;
+
+static const uint8_t KEY_A = 0x04, KEY_1 = 0x1E, KEY_2 = 0x1F, KEY_3 = 0x20, KEY_4 = 0x21,
+                     KEY_5 = 0x22, KEY_6 = 0x23, KEY_7 = 0x24, KEY_8 = 0x25, KEY_9 = 0x26,
+                     KEY_0 = 0x27, KEY_SPACE = 0x2C, KEY_MINUS = 0x2D, KEY_EQUAL = 0x2E,
+                     KEY_LEFT_BRACE = 0x2F, KEY_RIGHT_BRACE = 0x30, KEY_BACKSLASH = 0x31,
+                     KEY_SEMICOLON = 0x33, KEY_QUOTE = 0x34, KEY_TILDE = 0x35, KEY_COMMA = 0x36,
+                     KEY_PERIOD = 0x37, KEY_SLASH = 0x38;
+
+static uint8_t coreAscii(char ch) {
+  switch (ch) {
+    case ' ':  return KEY_SPACE;
+    case '!':  return KEY_1 + SHIFT_MASK;
+    case '"':  return KEY_QUOTE + SHIFT_MASK;
+    case '#':  return KEY_3 + SHIFT_MASK;
+    case '$':  return KEY_4 + SHIFT_MASK;
+    case '%':  return KEY_5 + SHIFT_MASK;
+    case '&':  return KEY_7 + SHIFT_MASK;
+    case '\'': return KEY_QUOTE;
+    case '(':  return KEY_9 + SHIFT_MASK;
+    case ')':  return KEY_0 + SHIFT_MASK;
+    case '*':  return KEY_8 + SHIFT_MASK;
+    case '+':  return KEY_EQUAL + SHIFT_MASK;
+    case ',':  return KEY_COMMA;
+    case '-':  return KEY_MINUS;
+    case '.':  return KEY_PERIOD;
+    case '/':  return KEY_SLASH;
+    case '0':  return KEY_0;
+    case ':':  return KEY_SEMICOLON + SHIFT_MASK;
+    case ';':  return KEY_SEMICOLON;
+    case '<':  return KEY_COMMA + SHIFT_MASK;
+    case '=':  return KEY_EQUAL;
+    case '>':  return KEY_PERIOD + SHIFT_MASK;
+    case '?':  return KEY_SLASH + SHIFT_MASK;
+    case '@':  return KEY_2 + SHIFT_MASK;
+    case '[':  return KEY_LEFT_BRACE;
+    case '\\': return KEY_BACKSLASH;
+    case ']':  return KEY_RIGHT_BRACE;
+    case '^':  return KEY_6 + SHIFT_MASK;
+    case '_':  return KEY_MINUS + SHIFT_MASK;
+    case '`':  return KEY_TILDE;
+    case '{':  return KEY_LEFT_BRACE + SHIFT_MASK;
+    case '|':  return KEY_BACKSLASH + SHIFT_MASK;
+    case '}':  return KEY_RIGHT_BRACE + SHIFT_MASK;
+    case '~':  return KEY_TILDE + SHIFT_MASK;
+  }
+  if (ch >= '1' && ch <= '9') return (uint8_t)(KEY_1 + (ch - '1'));
+  if (ch >= 'a' && ch <= 'z') return (uint8_t)(KEY_A + (ch - 'a'));
+  if (ch >= 'A' && ch <= 'Z') return (uint8_t)(KEY_A + (ch - 'A') + SHIFT_MASK);
+  return 0;
+}
+
+// What the old handleKeyPress() put in the report for a character with
+// extra modifiers: the modifiers it pressed, Shift from the layout, the key
+static void runtimeChord(char ch, ModMask m, uint8_t &usage, ModMask &mods) {
+  const uint8_t keycode = coreAscii(ch);
+  usage = (uint8_t)(keycode & 0x3F);
+  mods = (keycode & SHIFT_MASK) ? (ModMask)(m | MOD_LSHIFT) : m;
+}
+
+static const ModMask MOD_COMBOS[] = {
+  MOD_NONE, MOD_LCTRL, MOD_LALT, MOD_LSHIFT,
+  (ModMask)(MOD_LCTRL | MOD_LALT), (ModMask)(MOD_LCTRL | MOD_LALT | MOD_LSHIFT),
+};
+
+// The translation is usable in constant expressions
+static_assert(packAction(KA_chord('p', MOD_LALT)) == (0x13 | (MOD_LALT << 8)), "Alt+p");
+static_assert(packAction(KA_base('?')) == (0x38 | (MOD_LSHIFT << 8)), "?");
+static_assert(packAction(KA_key(0xF000 | 0x3A)) == 0x3A, "F1");
+
+void setUp() {}
+void tearDown() {}
+
+// ================================
+// Tests
+// ================================
+
+void test_every_printable_character_matches_core() {
+  uint16_t checked = 0;
+  for (char ch = ' '; ch <= '~'; ++ch) {
+    uint8_t usage;
+    ModMask mods;
+    runtimeChord(ch, MOD_NONE, usage, mods);
+    TEST_ASSERT_TRUE_MESSAGE(usage != 0, "reference table has a gap");
+
+    const KeyAction ka = KA_base(ch);
+    char msg[32];
+    snprintf(msg, sizeof(msg), "character '%c'", ch);
+    TEST_ASSERT_TRUE_MESSAGE(ka.valid, msg);
+    TEST_ASSERT_EQUAL_HEX8_MESSAGE(usage, ka.usage, msg);
+    TEST_ASSERT_EQUAL_HEX8_MESSAGE(mods, ka.mods, msg);
+    ++checked;
+  }
+  TEST_ASSERT_EQUAL_UINT16(95, checked);
+}
+
+// Chord modifiers and the layout's Shift combine, through packing too
+void test_chords_pack_like_runtime() {
+  for (ModMask m : MOD_COMBOS) {
+    for (char ch = ' '; ch <= '~'; ++ch) {
+      uint8_t usage;
+      ModMask mods;
+      runtimeChord(ch, m, usage, mods);
+      const PackedAction a = packAction(KA_chord(ch, m));
+      TEST_ASSERT_FALSE(isLayerAction(a));
+      TEST_ASSERT_EQUAL_HEX8(usage, actionUsage(a));
+      TEST_ASSERT_EQUAL_HEX8(mods, actionMods(a));
+    }
+  }
+}
+
+// KEY_* values (0xF000 | usage) pass their usage straight through
+void test_keycodes_pass_through() {
+  for (uint16_t u = 0x04; u <= 0xA4; ++u) {
+    const PackedAction a = packAction(KA_chord_key((uint16_t)(0xF000 | u), MOD_LALT));
+    TEST_ASSERT_EQUAL_HEX8(u, actionUsage(a));
+    TEST_ASSERT_EQUAL_HEX8(MOD_LALT, actionMods(a));
+  }
+}
+
+void test_unmappable_keys_translate_to_zero() {
+  TEST_ASSERT_EQUAL_HEX16(0, hidUsageFor(0x01));
+  TEST_ASSERT_EQUAL_HEX16(0, hidUsageFor(0x7F));
+  TEST_ASSERT_EQUAL_HEX16(0, hidUsageFor(0xE9));   // Latin-1, not in the US layout
+  TEST_ASSERT_EQUAL_HEX16(0, hidUsageFor(0x1234));
+}
+
+void test_modifier_layer_and_empty_actions() {
+  const PackedAction shift = packAction(KA_mod(MOD_LSHIFT));
+  TEST_ASSERT_EQUAL_HEX8(0, actionUsage(shift));
+  TEST_ASSERT_EQUAL_HEX8(MOD_LSHIFT, actionMods(shift));
+  TEST_ASSERT_FALSE(isLayerAction(shift));
+
+  const PackedAction fn = packAction(KA_toggle(LAYER_FN));
+  TEST_ASSERT_TRUE(isLayerAction(fn));
+  TEST_ASSERT_EQUAL(LAYER_OP_TOGGLE, actionLayerOp(fn));
+  TEST_ASSERT_EQUAL_UINT8(LAYER_FN, actionLayer(fn));
+
+  TEST_ASSERT_EQUAL_HEX16(ACTION_NONE, packAction(KA_empty()));
+}
+
+// keymapTranslated() is what the keymap's static_assert checks
+void test_validator_rejects_bad_entries() {
+  static KeyAction km[NUM_LAYERS][NUM_ROWS][NUM_COLS];
+  for (auto &layer : km) {
+    for (auto &row : layer) {
+      for (auto &ka : row) ka = KA_empty();
+    }
+  }
+  km[0][0][0] = KA_chord('p', MOD_LALT);
+  km[0][9][7] = KA_mod(MOD_LSHIFT);
+  km[0][9][0] = KA_momentary(LAYER_FN);
+  km[1][0][0] = KA_key(0xF000 | 0x3A);
+  TEST_ASSERT_TRUE(keymapTranslated(km));
+
+  km[1][3][3] = KA_base('\x01');
+  TEST_ASSERT_FALSE(keymapTranslated(km));
+  km[1][3][3] = KA_momentary(0);
+  TEST_ASSERT_FALSE(keymapTranslated(km));
+  km[1][3][3] = KA_oneshot(NUM_LAYERS);
+  TEST_ASSERT_FALSE(keymapTranslated(km));
+  km[1][3][3] = KA_empty();
+  TEST_ASSERT_TRUE(keymapTranslated(km));
+
+  // The packed table holds the same usages and marks the populated columns
+  const PackedKeymap packed = packKeymap(km);
+  TEST_ASSERT_EQUAL_HEX16(0x13 | (MOD_LALT << 8), packed.actions[0][0][0]);
+  TEST_ASSERT_EQUAL_HEX16(0x3A, packed.actions[1][0][0]);
+  TEST_ASSERT_EQUAL_HEX16(0x0001, packed.validRows[0]);
+  TEST_ASSERT_EQUAL_HEX16(0x0081, packed.validRows[9]);
+  TEST_ASSERT_EQUAL_HEX16(0, packed.validRows[3]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_every_printable_character_matches_core);
+  RUN_TEST(test_chords_pack_like_runtime);
+  RUN_TEST(test_keycodes_pass_through);
+  RUN_TEST(test_unmappable_keys_translate_to_zero);
+  RUN_TEST(test_modifier_layer_and_empty_actions);
+  RUN_TEST(test_validator_rejects_bad_entries);
+  return UNITY_END();
+}
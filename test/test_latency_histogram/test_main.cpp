@@ -0,0 +1,83 @@
+// test_main.cpp: LatencyHistogram bucketing and percentiles
+#include <unity.h>
+#include "LatencyHistogram.h"
+
+static LatencyHistogram hist;
+
+void setUp() {
+  hist.reset();
+}
+
+void tearDown() {}
+
+// Every value lands in a bucket whose range holds it, and buckets are
+// never wider than a quarter of their lower bound
+void test_buckets_cover_values() {
+  static const uint32_t values[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 100, 600, 1000,
+                                    65535, 65536, 1000000, 0x7FFFFFFFu, 0xFFFFFFFFu};
+  for (uint32_t v : values) {
+    const uint8_t b = LatencyHistogram::bucketOf(v);
+    TEST_ASSERT_LESS_THAN_UINT32(LatencyHistogram::BUCKETS, b);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(v, LatencyHistogram::bucketMax(b));
+    if (b) TEST_ASSERT_LESS_THAN_UINT32(v, LatencyHistogram::bucketMax((uint8_t)(b - 1)));
+  }
+  TEST_ASSERT_EQUAL_UINT8(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(0xFFFFFFFFu));
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFFu, LatencyHistogram::bucketMax(LatencyHistogram::BUCKETS - 1));
+
+  for (uint8_t b = 5; b < LatencyHistogram::BUCKETS; ++b) {
+    const uint32_t lower = LatencyHistogram::bucketMax((uint8_t)(b - 1)) + 1;
+    TEST_ASSERT_EQUAL_UINT8(b, LatencyHistogram::bucketOf(lower));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(lower / 4, LatencyHistogram::bucketMax(b) - lower);
+  }
+}
+
+void test_empty() {
+  TEST_ASSERT_EQUAL_UINT32(0, hist.count());
+  TEST_ASSERT_EQUAL_UINT32(0, hist.max());
+  TEST_ASSERT_EQUAL_UINT32(0, hist.percentile(50));
+}
+
+// A percentile is the top of its bucket, never below the true value, and
+// capped at the recorded maximum
+void test_percentiles_never_understate() {
+  for (uint32_t v = 1; v <= 1000; ++v) hist.record(v);
+  TEST_ASSERT_EQUAL_UINT32(1000, hist.count());
+  TEST_ASSERT_EQUAL_UINT32(1000, hist.max());
+
+  const uint32_t p50 = hist.percentile(50);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(500, p50);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(500 + 500 / 4, p50);
+  const uint32_t p99 = hist.percentile(99);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(990, p99);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1000, p99);
+  TEST_ASSERT_EQUAL_UINT32(1000, hist.percentile(100));
+  TEST_ASSERT_EQUAL_UINT32(1, hist.percentile(0));
+}
+
+// One slow outlier shows at the top without moving the median
+void test_outlier() {
+  for (uint32_t i = 0; i < 99; ++i) hist.record(600);
+  hist.record(250000);
+  TEST_ASSERT_EQUAL_UINT32(LatencyHistogram::bucketMax(LatencyHistogram::bucketOf(600)), hist.percentile(50));
+  TEST_ASSERT_EQUAL_UINT32(hist.percentile(50), hist.percentile(99));
+  TEST_ASSERT_EQUAL_UINT32(250000, hist.percentile(100));
+  TEST_ASSERT_EQUAL_UINT32(250000, hist.max());
+}
+
+void test_reset() {
+  hist.record(42);
+  hist.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, hist.count());
+  TEST_ASSERT_EQUAL_UINT32(0, hist.max());
+  TEST_ASSERT_EQUAL_UINT32(0, hist.percentile(99));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_buckets_cover_values);
+  RUN_TEST(test_empty);
+  RUN_TEST(test_percentiles_never_understate);
+  RUN_TEST(test_outlier);
+  RUN_TEST(test_reset);
+  return UNITY_END();
+}
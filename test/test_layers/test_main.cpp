@@ -0,0 +1,234 @@
+// test_main.cpp: layer transitions with held keys, scan side to report
+#include <unity.h>
+#include "KeyDispatch.h"
+#include "KeyReporter.h"
+#include "KeymapImage.h"
+
+static const uint16_t QUEUE_SIZE = 64;
+
+// Positions of the test keymap
+static const uint8_t ROW = 1;
+static const uint8_t COL_KEY = 5;       // F1, Fn layer: F9
+static const uint8_t COL_PLAIN = 6;     // 'a', transparent on Fn
+static const uint8_t COL_MOMENTARY = 0;
+static const uint8_t COL_MOMENTARY2 = 1;
+static const uint8_t COL_TOGGLE = 2;
+static const uint8_t COL_ONESHOT = 3;
+
+static const uint8_t USAGE_A = 0x04;
+static const uint8_t USAGE_B = 0x05;
+static const uint8_t USAGE_F1 = 0x3A;
+static const uint8_t USAGE_F9 = 0x42;
+
+static PackedKeymap packed;
+static ResolvedKeymap resolved;
+static SpscQueue<KeyEvent, QUEUE_SIZE> *queue;
+static KeyDispatcher<QUEUE_SIZE> *keys;
+static KeyReporter reporter;
+
+void setUp() {
+  static KeyAction km[NUM_LAYERS][NUM_ROWS][NUM_COLS];
+  for (auto &layer : km) {
+    for (auto &row : layer) {
+      for (auto &ka : row) ka = KA_empty();
+    }
+  }
+  km[0][ROW][COL_MOMENTARY] = KA_momentary(LAYER_FN);
+  km[0][ROW][COL_MOMENTARY2] = KA_momentary(LAYER_FN);
+  km[0][ROW][COL_TOGGLE] = KA_toggle(LAYER_FN);
+  km[0][ROW][COL_ONESHOT] = KA_oneshot(LAYER_FN);
+  km[0][ROW][COL_KEY] = KA_key(0xF000 | USAGE_F1);
+  km[0][ROW][COL_PLAIN] = KA_base('a');
+  km[LAYER_FN][ROW][COL_KEY] = KA_key(0xF000 | USAGE_F9);
+  packed = packKeymap(km);
+  resolveKeymap(packed, resolved);
+
+  static SpscQueue<KeyEvent, QUEUE_SIZE> q;
+  static KeyDispatcher<QUEUE_SIZE> d(q);
+  KeyEvent ev;
+  while (q.pop(ev)) {}
+  queue = &q;
+  keys = &d;
+  keys->begin(resolved);
+  reporter = KeyReporter();
+}
+
+void tearDown() {}
+
+// ================================
+// Helpers
+// ================================
+
+static void press(uint8_t c) { keys->press(ROW, c, 0); }
+static void release(uint8_t c) { keys->release(ROW, c, 0); }
+
+// Drains the queue into the reporter, as keyboardReport() does
+static KeyboardReport report() {
+  KeyEvent ev;
+  while (queue->pop(ev)) reporter.apply(ev);
+  KeyboardReport rep;
+  reporter.takeChanged(rep);
+  return reporter.builder().report();
+}
+
+static void assertKey(uint8_t usage) {
+  const KeyboardReport rep = report();
+  TEST_ASSERT_EQUAL_HEX8(usage, rep.keys[0]);
+  TEST_ASSERT_EQUAL_HEX8(0, rep.keys[1]);
+}
+
+// ================================
+// Tests
+// ================================
+
+// Hold Fn, press the key (F9), let go of Fn first: the release is F9's
+void test_momentary_release_order() {
+  press(COL_MOMENTARY);
+  press(COL_KEY);
+  assertKey(USAGE_F9);
+  release(COL_MOMENTARY);
+  TEST_ASSERT_EQUAL_HEX16(packAction(KA_key(0xF000 | USAGE_F9)), keys->heldAction(ROW, COL_KEY));
+  assertKey(USAGE_F9);
+  release(COL_KEY);
+  assertKey(0);
+
+  // Back on the base layer
+  press(COL_KEY);
+  assertKey(USAGE_F1);
+}
+
+// A key held from the base layer keeps its base action across an Fn press
+void test_held_base_key_across_fn() {
+  press(COL_KEY);
+  press(COL_MOMENTARY);
+  assertKey(USAGE_F1);
+  release(COL_KEY);
+  assertKey(0);
+  press(COL_KEY);
+  assertKey(USAGE_F9);
+}
+
+// Transparent positions fall through to the base layer
+void test_transparent_falls_through() {
+  press(COL_MOMENTARY);
+  press(COL_PLAIN);
+  assertKey(USAGE_A);
+}
+
+// Two momentary keys for the same layer: it stays up until both are released
+void test_two_momentary_keys() {
+  press(COL_MOMENTARY);
+  press(COL_MOMENTARY2);
+  release(COL_MOMENTARY);
+  press(COL_KEY);
+  assertKey(USAGE_F9);
+  release(COL_KEY);
+  release(COL_MOMENTARY2);
+  press(COL_KEY);
+  assertKey(USAGE_F1);
+}
+
+void test_toggle() {
+  press(COL_TOGGLE);
+  release(COL_TOGGLE);
+  press(COL_KEY);
+  assertKey(USAGE_F9);
+
+  // Toggling off with the key still held: it keeps F9 until released
+  press(COL_TOGGLE);
+  release(COL_TOGGLE);
+  assertKey(USAGE_F9);
+  release(COL_KEY);
+  press(COL_KEY);
+  assertKey(USAGE_F1);
+}
+
+// One-shot: the next key press only, and a held key keeps its action
+void test_oneshot() {
+  press(COL_ONESHOT);
+  release(COL_ONESHOT);
+  press(COL_KEY);
+  press(COL_PLAIN);
+  KeyboardReport rep = report();
+  TEST_ASSERT_EQUAL_HEX8(USAGE_F9, rep.keys[0]);
+  TEST_ASSERT_EQUAL_HEX8(USAGE_A, rep.keys[1]);
+  release(COL_KEY);
+  press(COL_KEY);
+  rep = report();
+  TEST_ASSERT_EQUAL_HEX8(USAGE_F1, rep.keys[0]);
+  TEST_ASSERT_EQUAL_HEX8(USAGE_A, rep.keys[1]);
+}
+
+// Layer keys queue events but never change the report
+void test_layer_keys_leave_report() {
+  press(COL_MOMENTARY);
+  press(COL_TOGGLE);
+  TEST_ASSERT_FALSE(queue->empty());
+  KeyboardReport rep;
+  KeyEvent ev;
+  while (queue->pop(ev)) reporter.apply(ev);
+  TEST_ASSERT_FALSE(reporter.takeChanged(rep));
+}
+
+// A keymap switch while a key is held keeps the held action
+void test_keymap_switch_while_held() {
+  static ResolvedKeymap other;
+  PackedKeymap edited = packed;
+  edited.actions[0][ROW][COL_KEY] = packAction(KA_base('b'));
+  resolveKeymap(edited, other);
+
+  press(COL_KEY);
+  keys->layers().setKeymap(other);
+  assertKey(USAGE_F1);
+  release(COL_KEY);
+  assertKey(0);
+  press(COL_KEY);
+  assertKey(USAGE_B);
+}
+
+// Release-all drops the held keys and the layers; the replay clears the report
+void test_release_all_resets_layers() {
+  press(COL_TOGGLE);
+  release(COL_TOGGLE);
+  press(COL_MOMENTARY);
+  press(COL_KEY);
+  assertKey(USAGE_F9);
+
+  keys->releaseAll();
+  TEST_ASSERT_TRUE(keys->beginScan());
+  assertKey(0);
+  TEST_ASSERT_EQUAL_HEX16(ACTION_NONE, keys->heldAction(ROW, COL_KEY));
+
+  // The keys' physical releases after the reset are no-ops
+  release(COL_KEY);
+  release(COL_MOMENTARY);
+  TEST_ASSERT_TRUE(queue->empty());
+  press(COL_KEY);
+  assertKey(USAGE_F1);
+}
+
+// The console values the keymap comment gives for binding a layer key
+void test_console_layer_actions() {
+  TEST_ASSERT_EQUAL_HEX16(0x9001, packAction(KA_momentary(LAYER_FN)));
+  TEST_ASSERT_EQUAL_HEX16(0xA001, packAction(KA_toggle(LAYER_FN)));
+  TEST_ASSERT_EQUAL_HEX16(0xB001, packAction(KA_oneshot(LAYER_FN)));
+  TEST_ASSERT_TRUE(keymapActionValid(0x9001));
+  TEST_ASSERT_TRUE(keymapActionValid(0xA001));
+  TEST_ASSERT_TRUE(keymapActionValid(0xB001));
+  TEST_ASSERT_TRUE(keymapActionValid(USAGE_F9));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_momentary_release_order);
+  RUN_TEST(test_held_base_key_across_fn);
+  RUN_TEST(test_transparent_falls_through);
+  RUN_TEST(test_two_momentary_keys);
+  RUN_TEST(test_toggle);
+  RUN_TEST(test_oneshot);
+  RUN_TEST(test_layer_keys_leave_report);
+  RUN_TEST(test_keymap_switch_while_held);
+  RUN_TEST(test_release_all_resets_layers);
+  RUN_TEST(test_console_layer_actions);
+  return UNITY_END();
+}
@@ -0,0 +1,41 @@
+// log_sites.cpp: one call site per LOG_* macro, compiled with every level off
+#include <stdint.h>
+#include "Trace.h"
+
+#define LOG_LEVEL_DEFAULT 0
+#include "Log.h"
+
+static_assert(LOG_LEVEL_SCAN == LOG_LEVEL_NONE && LOG_LEVEL_DEBOUNCE == LOG_LEVEL_NONE &&
+              LOG_LEVEL_HID == LOG_LEVEL_NONE && LOG_LEVEL_SERIAL == LOG_LEVEL_NONE,
+              "this file checks disabled call sites");
+
+// Declared as in utils.h but defined nowhere in this test: a disabled site
+// that still referenced either one would fail to link
+void debugPrintf(const char *format, ...);
+void trace(TraceEvent event, uint8_t row, uint8_t col, uint8_t arg0, uint8_t arg1, uint32_t timeUs);
+
+// Bumped by every argument expression; stays 0 if none is evaluated
+int logArgsEvaluated = 0;
+
+static unsigned arg() { return (unsigned)++logArgsEvaluated; }
+
+void logSites(uint8_t row, uint32_t now) {
+  LOG_SCAN_ERROR("LOGSITE-scan-error %u", arg());
+  LOG_SCAN_INFO("LOGSITE-scan-info %u", arg());
+  LOG_SCAN_DEBUG("LOGSITE-scan-debug %u row=%u", arg(), (unsigned)row);
+  LOG_DEBOUNCE_ERROR("LOGSITE-debounce-error %u", arg());
+  LOG_DEBOUNCE_INFO("LOGSITE-debounce-info %u", arg());
+  LOG_DEBOUNCE_DEBUG("LOGSITE-debounce-debug %u", arg());
+  LOG_HID_ERROR("LOGSITE-hid-error %u", arg());
+  LOG_HID_INFO("LOGSITE-hid-info %u", arg());
+  LOG_HID_DEBUG("LOGSITE-hid-debug %u", arg());
+  LOG_HID_TRACE(TRACE_PRESS, row, (uint8_t)arg(), 0, 0, now);
+  LOG_SERIAL_ERROR("LOGSITE-serial-error %u", arg());
+  LOG_SERIAL_INFO("LOGSITE-serial-info %u", arg());
+  LOG_SERIAL_DEBUG("LOGSITE-serial-debug %u", arg());
+}
+
+// A string that does reach the binary, so the search has something to find
+const char *logSiteControl() {
+  return "LOGSITE-control";
+}
@@ -0,0 +1,231 @@
+// test_main.cpp: MatrixIO.h against the simulated port registers
+#include <stdio.h>
+#include <unity.h>
+#include "MatrixIO.h"
+
+// ================================
+// Helpers
+// ================================
+
+// Column word the old way, one pin lookup per column as digitalRead() did
+static uint16_t readColumnsPerPin() {
+  uint16_t pressed = 0;
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    const PinLoc loc = pinLoc[colPins[c]];
+    if (!(readPortPSR(loc.port) & (1u << loc.bit))) pressed |= (uint16_t)(1u << c);
+  }
+  return pressed;
+}
+
+// Row select the old way: every other row reconfigured as an input, then the
+// selected row as an output driven LOW (one register access per pin call)
+static void selectRowPerPin(uint8_t row) {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    if (r != row) writePortSet(rowDrive.rows[r].port, rowDrive.rows[r].mask);
+  }
+  writePortClear(rowDrive.rows[row].port, rowDrive.rows[row].mask); // pinMode(OUTPUT)
+  writePortClear(rowDrive.rows[row].port, rowDrive.rows[row].mask); // digitalWrite(LOW)
+}
+
+static void releaseRowsPerPin() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) writePortSet(rowDrive.rows[r].port, rowDrive.rows[r].mask);
+}
+
+// Rows whose drive bit is currently LOW
+static uint16_t selectedRows() {
+  uint16_t rows = 0;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    if (!(simGpio().dr[rowDrive.rows[r].port] & rowDrive.rows[r].mask)) rows |= (uint16_t)(1u << r);
+  }
+  return rows;
+}
+
+static uint8_t portsHoldingRows() {
+  uint8_t n = 0;
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    if (rowDrive.portMask[p]) ++n;
+  }
+  return n;
+}
+
+// xorshift32: repeatable port contents
+static uint32_t nextRandom(uint32_t &x) {
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+static uint8_t portsHoldingColumns() {
+  return (uint8_t)__builtin_popcount(colGather.portMask);
+}
+
+void setUp() {
+  simGpio() = SimGpio();
+}
+
+void tearDown() {}
+
+// ================================
+// Column gather
+// ================================
+
+void test_gather_matches_pin_table() {
+  uint32_t seed = 0x12345678u;
+  for (int i = 0; i < 1000; ++i) {
+    for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().psr[p] = nextRandom(seed);
+    TEST_ASSERT_EQUAL_HEX16(readColumnsPerPin(), readColumns());
+  }
+}
+
+void test_each_column_reads_alone() {
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().psr[p] = 0xFFFFFFFFu;
+    const PinLoc loc = pinLoc[colPins[c]];
+    simGpio().psr[loc.port] &= ~(1u << loc.bit);
+    TEST_ASSERT_EQUAL_HEX16((uint16_t)(1u << c), readColumns());
+  }
+}
+
+void test_released_columns_read_zero() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().psr[p] = 0xFFFFFFFFu;
+  TEST_ASSERT_EQUAL_HEX16(0, readColumns());
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().psr[p] = 0;
+  TEST_ASSERT_EQUAL_HEX16(COL_MASK, readColumns());
+}
+
+void test_read_columns_reads_each_port_once() {
+  (void)readColumns();
+  TEST_ASSERT_EQUAL_UINT32(portsHoldingColumns(), simGpio().psrReads);
+
+  simGpio().psrReads = 0;
+  (void)readColumnsPerPin();
+  TEST_ASSERT_EQUAL_UINT32(NUM_COLS, simGpio().psrReads);
+}
+
+// ================================
+// Row drive
+// ================================
+
+void test_select_row_is_one_write() {
+  releaseAllRows();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    simGpio().drWrites = 0;
+    selectRow(r);
+    TEST_ASSERT_EQUAL_UINT32(1, simGpio().drWrites);
+    TEST_ASSERT_EQUAL_HEX16((uint16_t)(1u << r), selectedRows());
+    releaseRow(r);
+    TEST_ASSERT_EQUAL_UINT32(2, simGpio().drWrites);
+    TEST_ASSERT_EQUAL_HEX16(0, selectedRows());
+  }
+}
+
+void test_release_all_one_write_per_port() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) selectRow(r);
+  TEST_ASSERT_EQUAL_HEX16((1u << NUM_ROWS) - 1, selectedRows());
+  simGpio().drWrites = 0;
+  releaseAllRows();
+  TEST_ASSERT_EQUAL_UINT32(portsHoldingRows(), simGpio().drWrites);
+  TEST_ASSERT_EQUAL_HEX16(0, selectedRows());
+}
+
+// Any-key probe: every row selected with one write per port holding rows
+void test_select_all_one_write_per_port() {
+  releaseAllRows();
+  simGpio().drWrites = 0;
+  selectAllRows();
+  TEST_ASSERT_EQUAL_UINT32(portsHoldingRows(), simGpio().drWrites);
+  TEST_ASSERT_EQUAL_HEX16((1u << NUM_ROWS) - 1, selectedRows());
+  releaseAllRows();
+  TEST_ASSERT_EQUAL_HEX16(0, selectedRows());
+}
+
+// Row drive only touches row bits: column pins on the same ports stay put
+void test_row_drive_leaves_other_bits() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().dr[p] = 0xA5A5A5A5u;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) selectRow(r);
+  releaseAllRows();
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    TEST_ASSERT_EQUAL_HEX32(0xA5A5A5A5u | rowDrive.portMask[p], simGpio().dr[p]);
+  }
+}
+
+void test_select_all_leaves_other_bits() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) simGpio().dr[p] = 0xA5A5A5A5u;
+  selectAllRows();
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    TEST_ASSERT_EQUAL_HEX32(0xA5A5A5A5u & ~rowDrive.portMask[p], simGpio().dr[p]);
+  }
+  releaseAllRows();
+}
+
+void test_row_reads_low() {
+  simGpio().psr[rowDrive.rows[4].port] = 0xFFFFFFFFu;
+  TEST_ASSERT_FALSE(rowReadsLow(4));
+  simGpio().psr[rowDrive.rows[4].port] &= ~rowDrive.rows[4].mask;
+  TEST_ASSERT_TRUE(rowReadsLow(4));
+}
+
+// Column recovery measurement: every column, and only columns, becomes an
+// output driven LOW, then goes back to an input
+void test_column_drive_touches_only_columns() {
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    simGpio().dr[p] = 0xFFFFFFFFu;
+    simGpio().gdir[p] = rowDrive.portMask[p];
+  }
+  driveColumnsLow();
+  uint32_t colBits[NUM_PORTS] = {};
+  for (uint8_t c = 0; c < NUM_COLS; ++c) colBits[pinLoc[colPins[c]].port] |= 1u << pinLoc[colPins[c]].bit;
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) {
+    TEST_ASSERT_EQUAL_HEX32(colBits[p], colDrive.portMask[p]);
+    TEST_ASSERT_EQUAL_HEX32(rowDrive.portMask[p] | colBits[p], simGpio().gdir[p]);
+    TEST_ASSERT_EQUAL_HEX32(~colBits[p], simGpio().dr[p]);
+  }
+  releaseColumns();
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) TEST_ASSERT_EQUAL_HEX32(rowDrive.portMask[p], simGpio().gdir[p]);
+}
+
+// Register accesses for one full scan, per-pin calls against the port
+// tables; the counts are printed as the before/after figure
+void test_scan_register_accesses() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    selectRowPerPin(r);
+    (void)readColumnsPerPin();
+  }
+  releaseRowsPerPin();
+  const uint32_t before = simGpio().psrReads + simGpio().drWrites;
+
+  simGpio() = SimGpio();
+  selectRow(0);
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    (void)readColumns();
+    releaseRow(r);
+    if (r + 1 < NUM_ROWS) selectRow(r + 1);
+  }
+  TEST_ASSERT_EQUAL_UINT32(NUM_ROWS * portsHoldingColumns(), simGpio().psrReads);
+  TEST_ASSERT_EQUAL_UINT32(2u * NUM_ROWS, simGpio().drWrites);
+  const uint32_t after = simGpio().psrReads + simGpio().drWrites;
+  TEST_ASSERT_LESS_THAN_UINT32(before / 4, after);
+
+  char msg[80];
+  snprintf(msg, sizeof(msg), "register accesses per scan: per-pin %u, port tables %u",
+           (unsigned)before, (unsigned)after);
+  TEST_MESSAGE(msg);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_gather_matches_pin_table);
+  RUN_TEST(test_each_column_reads_alone);
+  RUN_TEST(test_released_columns_read_zero);
+  RUN_TEST(test_read_columns_reads_each_port_once);
+  RUN_TEST(test_select_row_is_one_write);
+  RUN_TEST(test_release_all_one_write_per_port);
+  RUN_TEST(test_select_all_one_write_per_port);
+  RUN_TEST(test_row_drive_leaves_other_bits);
+  RUN_TEST(test_select_all_leaves_other_bits);
+  RUN_TEST(test_row_reads_low);
+  RUN_TEST(test_column_drive_touches_only_columns);
+  RUN_TEST(test_scan_register_accesses);
+  return UNITY_END();
+}
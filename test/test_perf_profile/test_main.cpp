@@ -0,0 +1,87 @@
+// test_main.cpp: PerfCounter and ScanProfile with a simulated cycle counter
+#include <unity.h>
+#include "PerfProfile.h"
+
+static PerfCounter perf[PERF_STAGES];
+static ScanProfile profile;
+
+void setUp() {
+  for (uint8_t i = 0; i < PERF_STAGES; ++i) perf[i].reset();
+}
+
+void tearDown() {}
+
+void test_counter_min_max_total() {
+  PerfCounter c;
+  TEST_ASSERT_EQUAL_UINT32(0, c.getStats().samples);
+  c.record(50);
+  c.record(10);
+  c.record(30);
+  TEST_ASSERT_EQUAL_UINT32(3, c.getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(10, c.getStats().minCycles);
+  TEST_ASSERT_EQUAL_UINT32(50, c.getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(90, (uint32_t)c.getStats().totalCycles);
+
+  // The first sample after a reset sets the minimum, whatever it was
+  c.reset();
+  c.record(70);
+  TEST_ASSERT_EQUAL_UINT32(70, c.getStats().minCycles);
+}
+
+// Laps charge the time since the previous one; a stage lapped twice in a
+// scan gets one sample holding the sum
+void test_laps_sum_per_scan() {
+  profile.begin(1000);
+  profile.lap(PERF_SELECT, 1100);     // 100
+  profile.lap(PERF_READ, 1110);       // 10
+  profile.lap(PERF_SELECT, 1150);     // 40
+  profile.lap(PERF_DEBOUNCE, 1170);   // 20
+  profile.end(1200, perf);
+
+  TEST_ASSERT_EQUAL_UINT32(1, perf[PERF_SELECT].getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(140, perf[PERF_SELECT].getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(10, perf[PERF_READ].getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(20, perf[PERF_DEBOUNCE].getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(200, perf[PERF_SCAN].getStats().maxCycles);
+}
+
+// Stages that did not run in a scan (the fast path skips debounce and
+// dispatch) get no sample, so they are not averaged down by zeros
+void test_skipped_stages_not_sampled() {
+  profile.begin(0);
+  profile.lap(PERF_SELECT, 5);
+  profile.lap(PERF_READ, 6);
+  profile.end(8, perf);
+
+  TEST_ASSERT_EQUAL_UINT32(0, perf[PERF_DEBOUNCE].getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(0, perf[PERF_DISPATCH].getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(1, perf[PERF_SCAN].getStats().samples);
+
+  // The next scan starts from nothing
+  profile.begin(100);
+  profile.lap(PERF_DISPATCH, 103);
+  profile.end(103, perf);
+  TEST_ASSERT_EQUAL_UINT32(1, perf[PERF_SELECT].getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(1, perf[PERF_DISPATCH].getStats().samples);
+  TEST_ASSERT_EQUAL_UINT32(3, perf[PERF_DISPATCH].getStats().maxCycles);
+}
+
+// The cycle counter wraps mid-scan
+void test_counter_wrap() {
+  profile.begin(0xFFFFFFF0u);
+  profile.lap(PERF_SELECT, 0xFFFFFFFAu);
+  profile.lap(PERF_READ, 0x00000006u);
+  profile.end(0x00000010u, perf);
+  TEST_ASSERT_EQUAL_UINT32(10, perf[PERF_SELECT].getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(12, perf[PERF_READ].getStats().maxCycles);
+  TEST_ASSERT_EQUAL_UINT32(32, perf[PERF_SCAN].getStats().maxCycles);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_counter_min_max_total);
+  RUN_TEST(test_laps_sum_per_scan);
+  RUN_TEST(test_skipped_stages_not_sampled);
+  RUN_TEST(test_counter_wrap);
+  return UNITY_END();
+}
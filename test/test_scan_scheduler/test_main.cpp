@@ -0,0 +1,154 @@
+// test_main.cpp: ScanScheduler deadlines against a simulated clock
+#include <unity.h>
+#include "ScanScheduler.h"
+
+static const uint32_t PERIOD_US = 1000;
+static const uint32_t SLACK_US = 50;
+
+static ScanScheduler sched;
+
+void setUp() {
+  sched = ScanScheduler();
+}
+
+void tearDown() {}
+
+void test_on_time_ticks() {
+  const uint32_t t0 = 5000;
+  sched.start(PERIOD_US, SLACK_US, t0);
+  TEST_ASSERT_EQUAL_UINT32(t0 + PERIOD_US, sched.nextDeadline());
+
+  for (uint32_t k = 1; k <= 10; ++k) {
+    TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(t0 + k * PERIOD_US));
+    TEST_ASSERT_EQUAL_UINT32(t0 + (k + 1) * PERIOD_US, sched.nextDeadline());
+  }
+  const ScanStats &s = sched.getStats();
+  TEST_ASSERT_EQUAL_UINT32(10, s.ticks);
+  TEST_ASSERT_EQUAL_UINT32(0, s.late);
+  TEST_ASSERT_EQUAL_UINT32(0, s.missed);
+  TEST_ASSERT_EQUAL_UINT32(0, s.maxLateUs);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US, s.minPeriodUs);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US, s.maxPeriodUs);
+}
+
+// Timer granularity: a tick a few microseconds early is on time
+void test_early_tick_is_on_time() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(PERIOD_US - 3));
+  TEST_ASSERT_EQUAL_UINT32(2 * PERIOD_US, sched.nextDeadline());
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getStats().late);
+}
+
+// A late tick does not shift the grid; only lateness past the slack counts
+void test_late_tick_keeps_grid() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  sched.onTick(PERIOD_US + SLACK_US);       // at the slack: not late
+  sched.onTick(2 * PERIOD_US + 300);        // late
+  TEST_ASSERT_EQUAL_UINT32(3 * PERIOD_US, sched.nextDeadline());
+  sched.onTick(3 * PERIOD_US);
+
+  const ScanStats &s = sched.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1, s.late);
+  TEST_ASSERT_EQUAL_UINT32(0, s.missed);
+  TEST_ASSERT_EQUAL_UINT32(300, s.maxLateUs);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US - 300, s.minPeriodUs);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US + 300 - SLACK_US, s.maxPeriodUs);
+}
+
+// A tick more than a period late skips the deadlines it overran
+void test_overrun_skips_deadlines() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  TEST_ASSERT_EQUAL_UINT32(2, sched.onTick(PERIOD_US + 2 * PERIOD_US + 500));
+  TEST_ASSERT_EQUAL_UINT32(4 * PERIOD_US, sched.nextDeadline());
+  TEST_ASSERT_EQUAL_UINT32(2, sched.getStats().missed);
+  TEST_ASSERT_EQUAL_UINT32(1, sched.getStats().late);
+  TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(4 * PERIOD_US));
+}
+
+void test_micros_wraparound() {
+  const uint32_t t0 = 0xFFFFFFFFu - 2500;
+  sched.start(PERIOD_US, SLACK_US, t0);
+  for (uint32_t k = 1; k <= 5; ++k) {
+    TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(t0 + k * PERIOD_US));
+  }
+  // Late across the wrap, then an overrun across it
+  TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(t0 + 6 * PERIOD_US + 200));
+  TEST_ASSERT_EQUAL_UINT32(1, sched.onTick(t0 + 8 * PERIOD_US + 10));
+
+  const ScanStats &s = sched.getStats();
+  TEST_ASSERT_EQUAL_UINT32(1, s.missed);
+  TEST_ASSERT_EQUAL_UINT32(2, s.late);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US + 10, s.maxLateUs);
+  TEST_ASSERT_EQUAL_UINT32(t0 + 9 * PERIOD_US, sched.nextDeadline());
+}
+
+// After the timer restarts (idle wake), the grid starts over but the
+// stats carry on
+void test_resync_keeps_stats() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  sched.onTick(PERIOD_US + 400);
+  sched.resync(10 * PERIOD_US + 123, PERIOD_US);
+  TEST_ASSERT_EQUAL_UINT32(11 * PERIOD_US + 123, sched.nextDeadline());
+  TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(11 * PERIOD_US + 123));
+
+  const ScanStats &s = sched.getStats();
+  TEST_ASSERT_EQUAL_UINT32(2, s.ticks);
+  TEST_ASSERT_EQUAL_UINT32(1, s.late);
+  TEST_ASSERT_EQUAL_UINT32(400, s.maxLateUs);
+}
+
+// Like a PIT reload, a new period applies from the interval after the
+// running one
+void test_reprogram_applies_next_interval() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  sched.reprogram(800);
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US, sched.periodUs());
+  sched.onTick(PERIOD_US);
+  TEST_ASSERT_EQUAL_UINT32(800, sched.periodUs());
+  TEST_ASSERT_EQUAL_UINT32(PERIOD_US + 800, sched.nextDeadline());
+  TEST_ASSERT_EQUAL_UINT32(0, sched.onTick(PERIOD_US + 800));
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getStats().late);
+}
+
+void test_stats_reset() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  sched.onTick(PERIOD_US);
+  sched.onTick(2 * PERIOD_US + 900);
+
+  sched.resetStats();
+  const ScanStats &s = sched.getStats();
+  TEST_ASSERT_EQUAL_UINT32(0, s.ticks);
+  TEST_ASSERT_EQUAL_UINT32(0, s.late);
+  TEST_ASSERT_EQUAL_UINT32(0, s.maxLateUs);
+  TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, s.minPeriodUs);
+  TEST_ASSERT_EQUAL_UINT32(0, s.maxPeriodUs);
+  // The grid is untouched by a stats reset
+  TEST_ASSERT_EQUAL_UINT32(3 * PERIOD_US, sched.nextDeadline());
+}
+
+void test_fast_path_counted_and_reset() {
+  sched.start(PERIOD_US, SLACK_US, 0);
+  sched.onTick(PERIOD_US);
+  sched.onFastPath();
+  sched.onTick(2 * PERIOD_US);
+  sched.onFastPath();
+  TEST_ASSERT_EQUAL_UINT32(2, sched.getStats().fastPath);
+  TEST_ASSERT_EQUAL_UINT32(2, sched.getStats().ticks);
+
+  sched.resetStats();
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getStats().fastPath);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_on_time_ticks);
+  RUN_TEST(test_early_tick_is_on_time);
+  RUN_TEST(test_late_tick_keeps_grid);
+  RUN_TEST(test_overrun_skips_deadlines);
+  RUN_TEST(test_micros_wraparound);
+  RUN_TEST(test_resync_keeps_stats);
+  RUN_TEST(test_reprogram_applies_next_interval);
+  RUN_TEST(test_stats_reset);
+  RUN_TEST(test_fast_path_counted_and_reset);
+  return UNITY_END();
+}
@@ -0,0 +1,487 @@
+// test_main.cpp: row settling against an RC model of the matrix
+#include <stdio.h>
+#include <unity.h>
+#include "MatrixIO.h"
+#include "Debounce.h"
+#include "SettleCalibration.h"
+
+// ================================
+// Matrix model
+//
+// A selected row line falls LOW rowFall[r] cycles after its select. While
+// it is LOW, every held key on it pulls its column LOW. When the row is
+// released, those columns take colRise cycles to recover through their
+// pull-ups, so the next row read too early sees a phantom key. A column
+// driven LOW as an output (the recovery measurement) takes the same
+// colRise to come back after it is returned to an input.
+// ================================
+
+struct MatrixModel {
+  uint32_t rowFall[NUM_ROWS];
+  uint32_t colRise;
+  uint16_t held[NUM_ROWS];     // bit c = key (r, c) closed
+
+  bool selected[NUM_ROWS];
+  uint32_t changedAt[NUM_ROWS]; // cycle of the last select/release
+  bool pulledAtRelease[NUM_ROWS];
+
+  bool colDriven[NUM_COLS];
+  uint32_t colReleasedAt[NUM_COLS];
+  bool colEverDriven[NUM_COLS];
+};
+
+static MatrixModel model;
+
+static bool rowLow(uint8_t r, uint32_t now) {
+  return model.selected[r] && (now - model.changedAt[r]) >= model.rowFall[r];
+}
+
+static void setLine(uint32_t (&psr)[NUM_PORTS], const PinLoc &loc, bool low) {
+  if (low) psr[loc.port] &= ~(1u << loc.bit);
+}
+
+static void runModel(SimGpio &sim) {
+  const uint32_t now = sim.cycles;
+
+  // Row transitions since the last call
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    const bool sel = !(sim.dr[rowDrive.rows[r].port] & rowDrive.rows[r].mask);
+    if (sel == model.selected[r]) continue;
+    if (!sel) model.pulledAtRelease[r] = rowLow(r, now);
+    model.selected[r] = sel;
+    model.changedAt[r] = now;
+  }
+
+  // Column direction changes since the last call
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    const PinLoc &loc = pinLoc[colPins[c]];
+    const bool driven = (sim.gdir[loc.port] >> loc.bit) & 1;
+    if (driven == model.colDriven[c]) continue;
+    model.colDriven[c] = driven;
+    model.colEverDriven[c] = true;
+    if (!driven) model.colReleasedAt[c] = now;
+  }
+
+  uint32_t psr[NUM_PORTS] = {0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu};
+  for (uint8_t c = 0; c < NUM_COLS; ++c) {
+    const PinLoc &loc = pinLoc[colPins[c]];
+    const bool outLow = model.colDriven[c] && !((sim.dr[loc.port] >> loc.bit) & 1);
+    const bool rising = !model.colDriven[c] && model.colEverDriven[c] &&
+                        (now - model.colReleasedAt[c]) < model.colRise;
+    setLine(psr, loc, outLow || rising);
+  }
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    const bool low = rowLow(r, now);
+    const bool recovering = !model.selected[r] && model.pulledAtRelease[r] &&
+                            (now - model.changedAt[r]) < model.colRise;
+    setLine(psr, pinLoc[rowPins[r]], low);
+    if (!(low || recovering)) continue;
+    for (uint8_t c = 0; c < NUM_COLS; ++c) {
+      if (model.held[r] & (1u << c)) setLine(psr, pinLoc[colPins[c]], true);
+    }
+  }
+  for (uint8_t p = 0; p < NUM_PORTS; ++p) sim.psr[p] = psr[p];
+}
+
+// 0.5..2 us row fall and 3 us column recovery at 600 MHz
+static const uint32_t COL_RISE = 1800;
+
+static uint32_t rowFallOf(uint8_t r) {
+  return 300 + 100 * r;
+}
+
+// Settle that covers both the row's own fall and a column recovering from
+// the previous row
+static uint32_t safeSettle(uint8_t r) {
+  return rowFallOf(r) > COL_RISE ? rowFallOf(r) : COL_RISE;
+}
+
+// ================================
+// Scans
+// ================================
+
+struct ScanResult {
+  uint16_t rows[NUM_ROWS];
+  uint32_t cycles;
+};
+
+// The firmware's pipelined scan: row r+1 is selected before row r's work,
+// so the work counts toward r+1's settle time
+static ScanResult pipelinedScan(const uint32_t (&settle)[NUM_ROWS], uint32_t workCycles) {
+  ScanResult out = {};
+  const uint32_t start = simGpio().cycles;
+  selectRow(0);
+  uint32_t selectedAt = cycleCount();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    waitSettle(selectedAt, settle[r]);
+    out.rows[r] = readColumns();
+    releaseRow(r);
+    if (r + 1 < NUM_ROWS) {
+      selectRow(r + 1);
+      selectedAt = cycleCount();
+    }
+    simGpio().cycles += workCycles; // debounce and dispatch of row r
+  }
+  out.cycles = simGpio().cycles - start;
+  return out;
+}
+
+// The scan before pipelining: settle, read, then the work, one row at a time
+static ScanResult sequentialScan(const uint32_t (&settle)[NUM_ROWS], uint32_t workCycles) {
+  ScanResult out = {};
+  const uint32_t start = simGpio().cycles;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    selectRow(r);
+    waitSettle(cycleCount(), settle[r]);
+    out.rows[r] = readColumns();
+    releaseRow(r);
+    simGpio().cycles += workCycles;
+  }
+  out.cycles = simGpio().cycles - start;
+  return out;
+}
+
+void setUp() {
+  model = MatrixModel();
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) model.rowFall[r] = rowFallOf(r);
+  model.colRise = COL_RISE;
+  simGpio() = SimGpio();
+  simGpio().model = runModel;
+  releaseAllRows();
+  simGpio().cycles += 10 * COL_RISE;
+}
+
+void tearDown() {}
+
+// Keys stacked in one column over adjacent rows, plus a diagonal
+static void holdTestPattern() {
+  model.held[2] = 0x0010;
+  model.held[3] = 0x0010 | 0x0001;
+  model.held[4] = 0x2000;
+  model.held[7] = 0x0400;
+}
+
+void test_settled_scan_reads_exact_matrix() {
+  holdTestPattern();
+  uint32_t settle[NUM_ROWS];
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = safeSettle(r);
+  const ScanResult res = pipelinedScan(settle, 500);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(model.held, res.rows, NUM_ROWS);
+}
+
+// Reading a row before it has fallen misses its keys
+void test_short_settle_misses_keys() {
+  holdTestPattern();
+  uint32_t settle[NUM_ROWS] = {};
+  const ScanResult res = pipelinedScan(settle, 0);
+  TEST_ASSERT_EQUAL_HEX16(0, res.rows[7]);
+}
+
+// A row read while the previous row's column is still recovering shows a
+// phantom key in that column
+void test_column_recovery_phantom() {
+  model.held[4] = 0x2000;
+  uint32_t settle[NUM_ROWS];
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = rowFallOf(r);
+  const ScanResult res = pipelinedScan(settle, 0);
+  TEST_ASSERT_EQUAL_HEX16(0x2000, res.rows[4]);
+  TEST_ASSERT_EQUAL_HEX16(0x2000, res.rows[5]);
+}
+
+// Per-row work shorter than the settle time is hidden by the pipeline;
+// sequentially it adds up. Both scans must read the same matrix.
+void test_pipeline_overlaps_settle_with_work() {
+  holdTestPattern();
+  uint32_t settle[NUM_ROWS];
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = safeSettle(r);
+  const uint32_t work = 1200;
+
+  const ScanResult piped = pipelinedScan(settle, work);
+  simGpio().cycles += 10 * COL_RISE;
+  const ScanResult seq = sequentialScan(settle, work);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(seq.rows, piped.rows, NUM_ROWS);
+  TEST_ASSERT_EQUAL_HEX16_ARRAY(model.held, piped.rows, NUM_ROWS);
+
+  uint32_t settleTotal = 0;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settleTotal += settle[r];
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(settleTotal + NUM_ROWS * work, seq.cycles);
+  TEST_ASSERT_LESS_THAN_UINT32(settleTotal + 2 * work + NUM_ROWS * 16, piped.cycles);
+
+  char msg[80];
+  snprintf(msg, sizeof(msg), "scan cycles with %u work/row: sequential %u, pipelined %u",
+           (unsigned)work, (unsigned)seq.cycles, (unsigned)piped.cycles);
+  TEST_MESSAGE(msg);
+}
+
+// ================================
+// Idle fast path
+// ================================
+
+static uint32_t probeSettle() {
+  uint32_t longest = 0;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    if (safeSettle(r) > longest) longest = safeSettle(r);
+  }
+  return longest;
+}
+
+// Any-key probe: every row LOW, one column read
+static uint16_t probe() {
+  selectAllRows();
+  waitSettle(cycleCount(), probeSettle());
+  const uint16_t cols = readColumns();
+  releaseAllRows();
+  return cols;
+}
+
+void test_probe_sees_every_key() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    for (uint8_t c = 0; c < NUM_COLS; ++c) {
+      model.held[r] = (uint16_t)(1u << c);
+      TEST_ASSERT_EQUAL_HEX16((uint16_t)(1u << c), probe());
+      model.held[r] = 0;
+      simGpio().cycles += 10 * COL_RISE;
+    }
+  }
+  TEST_ASSERT_EQUAL_HEX16(0, probe());
+}
+
+typedef TimestampDebouncer<5> FastPathDebouncer;
+
+// One 1 ms scan as keyboardScan() runs it: with nothing held or settling,
+// the probe decides whether the rows are scanned at all
+static bool scanOnce(FastPathDebouncer &d, bool fastPath, uint32_t nowMs, uint16_t (&flipped)[NUM_ROWS]) {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) flipped[r] = 0;
+  if (fastPath && d.idle() && !probe()) return false;
+
+  uint32_t settle[NUM_ROWS];
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = safeSettle(r);
+  const ScanResult res = pipelinedScan(settle, 0);
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) flipped[r] = d.update(r, res.rows[r], nowMs);
+  return true;
+}
+
+// Keys held over [downMs, upMs)
+struct Hold {
+  uint8_t row;
+  uint8_t col;
+  uint32_t downMs;
+  uint32_t upMs;
+};
+
+static const Hold HOLDS[] = {
+  {0, 0, 20, 60},
+  {9, 13, 100, 101},   // 1 ms tap: too short to debounce
+  {4, 7, 150, 240},
+  {5, 7, 180, 200},    // same column, next row, inside the first hold
+  {2, 3, 400, 430},
+};
+
+static void applyHolds(uint32_t ms) {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) model.held[r] = 0;
+  for (const Hold &h : HOLDS) {
+    if (ms >= h.downMs && ms < h.upMs) model.held[h.row] |= (uint16_t)(1u << h.col);
+  }
+}
+
+// The fast path must report exactly what scanning every row reports, in
+// the same scan
+void test_fast_path_never_misses_or_delays() {
+  static FastPathDebouncer full, fast;
+  full.reset();
+  fast.reset();
+  uint32_t fastScans = 0;
+  uint32_t presses = 0;
+  for (uint32_t ms = 0; ms < 500; ++ms) {
+    applyHolds(ms);
+    uint16_t a[NUM_ROWS], b[NUM_ROWS];
+    scanOnce(full, false, ms, a);
+    simGpio().cycles += 600000;
+    if (!scanOnce(fast, true, ms, b)) ++fastScans;
+    simGpio().cycles += 600000;
+    TEST_ASSERT_EQUAL_HEX16_ARRAY(a, b, NUM_ROWS);
+    for (uint8_t r = 0; r < NUM_ROWS; ++r) presses += (uint32_t)__builtin_popcount(a[r] & full.state(r));
+  }
+  TEST_ASSERT_EQUAL_UINT32(4, presses);
+  TEST_ASSERT_GREATER_THAN_UINT32(300, fastScans);
+}
+
+// ================================
+// Settle calibration
+// ================================
+
+// 20 us reference, 100 ns steps, 8 matching reads at 600 MHz; no margin, so
+// the result is the measured delay
+static const SettleCalibrationConfig CAL = {12000, 60, 8, 0, 0, 0};
+static const uint32_t CAL_REST = 12000;
+
+static uint32_t sampleTransition(uint8_t row, uint32_t delayCycles) {
+  return sampleRowTransition(row, delayCycles, CAL_REST);
+}
+
+// The trial before the fix: the row selected from fully released lines
+static uint32_t sampleFromReleased(uint8_t row, uint32_t delayCycles) {
+  releaseAllRows();
+  waitSettle(cycleCount(), CAL_REST);
+  selectRow(row);
+  waitSettle(cycleCount(), delayCycles);
+  const uint32_t sample = readColumns() | ((uint32_t)rowReadsLow(row) << NUM_COLS);
+  releaseRow(row);
+  return sample;
+}
+
+void test_calibration_finds_row_fall() {
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    uint32_t measured = 0;
+    TEST_ASSERT_TRUE(calibrateRowSettle(r, sampleTransition, CAL, measured));
+    TEST_ASSERT_UINT32_WITHIN(CAL.stepCycles, rowFallOf(r), measured);
+  }
+}
+
+void test_calibration_adds_margin() {
+  const SettleCalibrationConfig cfg = {12000, 60, 8, 100, 300, 0};
+  uint32_t plain = 0, padded = 0;
+  TEST_ASSERT_TRUE(calibrateRowSettle(6, sampleTransition, CAL, plain));
+  TEST_ASSERT_TRUE(calibrateRowSettle(6, sampleTransition, cfg, padded));
+  TEST_ASSERT_EQUAL_UINT32(2 * plain + 300, padded);
+  TEST_ASSERT_EQUAL_UINT32(padded, settleWithMargin(plain, cfg));
+}
+
+// With a key held in the previous row, the transition trial waits for the
+// column to recover; a trial from released rows only sees the row fall and
+// leaves a phantom key in the scan
+void test_calibration_covers_column_recovery() {
+  model.held[4] = 0x0040;
+
+  uint32_t fromReleased = 0;
+  TEST_ASSERT_TRUE(calibrateRowSettle(5, sampleFromReleased, CAL, fromReleased));
+  TEST_ASSERT_LESS_THAN_UINT32(COL_RISE, fromReleased);
+
+  uint32_t transition = 0;
+  TEST_ASSERT_TRUE(calibrateRowSettle(5, sampleTransition, CAL, transition));
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(COL_RISE - CAL.stepCycles, transition);
+
+  uint32_t settle[NUM_ROWS];
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) settle[r] = safeSettle(r);
+  settle[5] = fromReleased;
+  TEST_ASSERT_EQUAL_HEX16(0x0040, pipelinedScan(settle, 0).rows[5]);
+  simGpio().cycles += 10 * COL_RISE;
+  settle[5] = transition;
+  TEST_ASSERT_EQUAL_HEX16(0, pipelinedScan(settle, 0).rows[5]);
+}
+
+static uint32_t sampleColumns(uint32_t delayCycles) {
+  return sampleColumnRecovery(delayCycles, CAL_REST);
+}
+
+void test_column_recovery_measured() {
+  uint32_t measured = 0;
+  TEST_ASSERT_TRUE(calibrateColumnRecovery(sampleColumns, CAL, measured));
+  TEST_ASSERT_UINT32_WITHIN(CAL.stepCycles, COL_RISE, measured);
+  TEST_ASSERT_EQUAL_HEX16(0, readColumns());
+}
+
+// A column that never rises (shorted LOW) fails the measurement
+static uint32_t sampleStuckColumn(uint32_t delayCycles) {
+  return sampleColumnRecovery(delayCycles, CAL_REST) | 0x0008;
+}
+
+void test_column_recovery_rejects_stuck_column() {
+  uint32_t out = 12345;
+  TEST_ASSERT_FALSE(calibrateColumnRecovery(sampleStuckColumn, CAL, out));
+  TEST_ASSERT_EQUAL_UINT32(12345, out);
+}
+
+void test_calibration_floor_applies() {
+  const SettleCalibrationConfig cfg = {12000, 60, 8, 100, 300, 3000};
+  uint32_t out = 0;
+  TEST_ASSERT_TRUE(calibrateRowSettle(0, sampleTransition, cfg, out));
+  TEST_ASSERT_EQUAL_UINT32(cfg.floorCycles, out);
+  TEST_ASSERT_EQUAL_UINT32(cfg.floorCycles, settleWithMargin(0, cfg));
+}
+
+// The firmware's calibrateSettle() at 600 MHz: 100% and 500 ns of margin,
+// the column recovery (with margin) as every row's floor
+static const SettleCalibrationConfig FIRMWARE_CAL = {12000, 60, 8, 100, 300, 0};
+static const uint32_t SELECT_SETTLE_CYCLES = 5 * 600;
+
+static void calibrateLikeFirmware(uint32_t (&settle)[NUM_ROWS]) {
+  SettleCalibrationConfig cfg = FIRMWARE_CAL;
+  uint32_t recovery = SELECT_SETTLE_CYCLES;
+  TEST_ASSERT_TRUE(calibrateColumnRecovery(sampleColumns, cfg, recovery));
+  cfg.floorCycles = recovery;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) {
+    TEST_ASSERT_TRUE(calibrateRowSettle(r, sampleTransition, cfg, settle[r]));
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(recovery, settle[r]);
+  }
+  simGpio().cycles += 10 * COL_RISE;
+}
+
+// Every key of row r-1 held in turn; row r must read clean
+static void expectNoPhantoms(const uint32_t (&settle)[NUM_ROWS]) {
+  for (uint8_t r = 1; r < NUM_ROWS; ++r) {
+    for (uint8_t c = 0; c < NUM_COLS; ++c) {
+      model.held[r - 1] = (uint16_t)(1u << c);
+      const ScanResult res = pipelinedScan(settle, 0);
+      TEST_ASSERT_EQUAL_HEX16(model.held[r - 1], res.rows[r - 1]);
+      TEST_ASSERT_EQUAL_HEX16(0, res.rows[r]);
+      model.held[r - 1] = 0;
+      simGpio().cycles += 10 * COL_RISE;
+    }
+  }
+}
+
+// Calibrated with no key held, the row trials only see the row lines fall;
+// the measured column recovery still keeps a key held in row r-1 out of
+// row r
+void test_calibration_without_held_keys_has_no_phantoms() {
+  uint32_t settle[NUM_ROWS];
+  calibrateLikeFirmware(settle);
+  expectNoPhantoms(settle);
+}
+
+// Short traces with fast pull-ups: rows come back well under the fixed
+// SELECT_SETTLE_US, still without phantoms
+void test_short_rows_below_default() {
+  model.colRise = 300;
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) model.rowFall[r] = 100;
+  uint32_t settle[NUM_ROWS];
+  calibrateLikeFirmware(settle);
+  for (uint8_t r = 0; r < NUM_ROWS; ++r) TEST_ASSERT_LESS_THAN_UINT32(SELECT_SETTLE_CYCLES / 2, settle[r]);
+  expectNoPhantoms(settle);
+}
+
+// A key bouncing during calibration: the reference reads disagree and the
+// row keeps its default
+static uint32_t bounceCalls = 0;
+
+static uint32_t sampleBouncing(uint8_t row, uint32_t delayCycles) {
+  model.held[row] = (++bounceCalls & 1) ? 0x0002 : 0;
+  return sampleRowTransition(row, delayCycles, CAL_REST);
+}
+
+void test_calibration_rejects_bouncing_row() {
+  uint32_t out = 12345;
+  TEST_ASSERT_FALSE(calibrateRowSettle(3, sampleBouncing, CAL, out));
+  TEST_ASSERT_EQUAL_UINT32(12345, out);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_settled_scan_reads_exact_matrix);
+  RUN_TEST(test_short_settle_misses_keys);
+  RUN_TEST(test_column_recovery_phantom);
+  RUN_TEST(test_pipeline_overlaps_settle_with_work);
+  RUN_TEST(test_probe_sees_every_key);
+  RUN_TEST(test_fast_path_never_misses_or_delays);
+  RUN_TEST(test_calibration_finds_row_fall);
+  RUN_TEST(test_calibration_adds_margin);
+  RUN_TEST(test_calibration_covers_column_recovery);
+  RUN_TEST(test_column_recovery_measured);
+  RUN_TEST(test_column_recovery_rejects_stuck_column);
+  RUN_TEST(test_calibration_floor_applies);
+  RUN_TEST(test_calibration_without_held_keys_has_no_phantoms);
+  RUN_TEST(test_short_rows_below_default);
+  RUN_TEST(test_calibration_rejects_bouncing_row);
+  return UNITY_END();
+}
@@ -0,0 +1,184 @@
+// test_main.cpp: SofAligner against a simulated SOF clock and PIT timer
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+#include "SofAligner.h"
+
+// ================================
+// Simulation
+//
+// Time runs in nanoseconds; the aligner sees microseconds, as micros()
+// gives on target. The host's SOF clock and the scan timer may disagree by
+// a few ppm. Like the PIT, a period handed back by onScan() only takes
+// effect after the interval already running.
+// ================================
+
+struct Sim {
+  SofAligner aligner;
+  uint32_t sofUs;
+  uint32_t periodUs;
+  int32_t timerPpm = 0;     // scan timer error against the SOF clock
+  bool sofRunning = true;
+
+  uint64_t now = 0;         // next scan tick
+  uint64_t nextSof = 0;
+  uint32_t running = 0;     // period of the interval now running
+  uint32_t minPeriod = UINT32_MAX;
+  uint32_t maxPeriod = 0;
+
+  Sim(uint32_t sof, uint32_t period, uint32_t lead, uint64_t firstScanNs)
+    : sofUs(sof), periodUs(period), now(firstScanNs), running(period) {
+    aligner.begin(sof, period, lead);
+  }
+
+  // One scan tick; returns its phase error
+  int32_t scan() {
+    while (nextSof <= now) {
+      if (sofRunning) aligner.onSof((uint32_t)(nextSof / 1000));
+      nextSof += (uint64_t)sofUs * 1000;
+    }
+    const uint32_t next = aligner.onScan((uint32_t)(now / 1000));
+    if (next < minPeriod) minPeriod = next;
+    if (next > maxPeriod) maxPeriod = next;
+    now += (uint64_t)running * (1000000 + timerPpm) / 1000;
+    running = next;
+    return aligner.phaseError();
+  }
+
+  // Scans until locked for 20 in a row; returns the scans it took
+  uint32_t lock(uint32_t limit) {
+    uint32_t run = 0;
+    for (uint32_t i = 1; i <= limit; ++i) {
+      if ((uint32_t)abs(scan()) <= SofAligner::LOCK_TOLERANCE) {
+        if (++run == 20) return i;
+      } else {
+        run = 0;
+      }
+    }
+    return UINT32_MAX;
+  }
+
+  // Worst |phase error| over n scans
+  uint32_t worst(uint32_t n) {
+    uint32_t w = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+      const uint32_t e = (uint32_t)abs(scan());
+      if (e > w) w = e;
+    }
+    return w;
+  }
+
+  // Where the next scan starts, relative to the last SOF before it
+  uint32_t phaseUs() const {
+    const uint64_t sofNs = (uint64_t)sofUs * 1000;
+    return (uint32_t)((now % sofNs) / 1000);
+  }
+};
+
+static void reportLock(const char *name, uint32_t scans) {
+  char msg[80];
+  snprintf(msg, sizeof(msg), "%s: locked after %u scans", name, (unsigned)scans);
+  TEST_MESSAGE(msg);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ================================
+// Tests
+// ================================
+
+// Full speed: 1 ms frames, 1 kHz scans, starting at an arbitrary phase
+void test_full_speed_locks_to_lead() {
+  Sim sim(1000, 1000, 30, 417300);
+  const uint32_t scans = sim.lock(200);
+  TEST_ASSERT_LESS_THAN_UINT32(60, scans);
+  reportLock("full speed", scans);
+
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SofAligner::LOCK_TOLERANCE, sim.worst(1000));
+  TEST_ASSERT_UINT32_WITHIN(SofAligner::LOCK_TOLERANCE + 1, 1000 - 30, sim.phaseUs());
+}
+
+// High speed: 125 us microframes, 8 kHz scans
+void test_high_speed_locks_to_lead() {
+  Sim sim(125, 125, 30, 11000);
+  const uint32_t scans = sim.lock(200);
+  TEST_ASSERT_LESS_THAN_UINT32(60, scans);
+  reportLock("high speed", scans);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SofAligner::LOCK_TOLERANCE, sim.worst(8000));
+  TEST_ASSERT_UINT32_WITHIN(SofAligner::LOCK_TOLERANCE + 1, 125 - 30, sim.phaseUs());
+}
+
+// 1 kHz scans on microframes: aligned to one of every eight
+void test_slow_scan_on_microframes() {
+  Sim sim(125, 1000, 30, 60000);
+  TEST_ASSERT_LESS_THAN_UINT32(60, sim.lock(200));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SofAligner::LOCK_TOLERANCE, sim.worst(1000));
+  TEST_ASSERT_UINT32_WITHIN(SofAligner::LOCK_TOLERANCE + 1, 125 - 30, sim.phaseUs() % 125);
+}
+
+// 8 kHz scans on full-speed frames: every scan keeps the phase in its window
+void test_fast_scan_on_frames() {
+  Sim sim(1000, 125, 30, 3000);
+  TEST_ASSERT_LESS_THAN_UINT32(100, sim.lock(400));
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(SofAligner::LOCK_TOLERANCE, sim.worst(8000));
+}
+
+// The scan timer and the host disagree (crystal tolerance); the lock holds
+void test_clock_drift_stays_locked() {
+  static const int32_t ppms[] = {-100, -20, 20, 100};
+  for (int32_t ppm : ppms) {
+    Sim sim(1000, 1000, 30, 250000);
+    sim.timerPpm = ppm;
+    TEST_ASSERT_LESS_THAN_UINT32(60, sim.lock(200));
+    sim.aligner.resetStats();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(SofAligner::LOCK_TOLERANCE, sim.worst(20000));
+    TEST_ASSERT_EQUAL_UINT32(20000, sim.aligner.getStats().lockedScans);
+  }
+}
+
+// Corrections never stretch or shrink a period by more than an eighth
+void test_corrections_bounded() {
+  Sim sim(1000, 1000, 30, 500000);
+  sim.worst(200);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(1000 - 1000 / 8, sim.minPeriod);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(1000 + 1000 / 8, sim.maxPeriod);
+}
+
+// Suspended bus: no SOFs, the timer goes back to nominal, then relocks
+void test_lost_sof_falls_back_to_nominal() {
+  Sim sim(1000, 1000, 30, 100000);
+  sim.lock(200);
+  sim.sofRunning = false;
+  for (uint32_t i = 0; i < 10; ++i) sim.scan();
+  TEST_ASSERT_EQUAL_UINT32(1000, sim.running);
+  TEST_ASSERT_GREATER_THAN_UINT32(0, sim.aligner.getStats().lostScans);
+
+  // Resume at a different phase
+  sim.now += 333000;
+  sim.sofRunning = true;
+  TEST_ASSERT_LESS_THAN_UINT32(60, sim.lock(200));
+}
+
+// After an idle wake the timer restarts at the nominal period, any phase
+void test_restart_relocks() {
+  Sim sim(1000, 1000, 30, 0);
+  sim.lock(200);
+  sim.now += 5000000 + 641000;   // asleep, then a column edge restarts the timer
+  sim.running = 1000;
+  sim.aligner.restart();
+  TEST_ASSERT_LESS_THAN_UINT32(60, sim.lock(200));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_speed_locks_to_lead);
+  RUN_TEST(test_high_speed_locks_to_lead);
+  RUN_TEST(test_slow_scan_on_microframes);
+  RUN_TEST(test_fast_scan_on_frames);
+  RUN_TEST(test_clock_drift_stays_locked);
+  RUN_TEST(test_corrections_bounded);
+  RUN_TEST(test_lost_sof_falls_back_to_nominal);
+  RUN_TEST(test_restart_relocks);
+  return UNITY_END();
+}
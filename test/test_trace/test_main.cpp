@@ -0,0 +1,122 @@
+// test_main.cpp: trace record layout, the [TRACE] line format and the ring's drops
+#include <string.h>
+#include <unity.h>
+#include "EventQueue.h"
+#include "Trace.h"
+
+void setUp() {}
+void tearDown() {}
+
+// ================================
+// Golden line
+//
+// "python trace_decode.py --check" reads GOLDEN_LINE and GOLDEN_DECODED
+// from this file and decodes one into the other, so the encoder here and
+// the decoder there cannot drift apart. Keep both as plain string
+// literals.
+// ================================
+
+static const char GOLDEN_LINE[] =
+  "[TRACE] "
+  "7856341200250402"  // PRESS, t=0x12345678, r2 c5, usage 0x04, LSHIFT
+  "0057341201250402"  // RELEASE, t=0x12345700
+  "E803000004050101"  // PRESS LAYER, t=1000, r0 c5, op 1, layer 1
+  "00000100039D0040"  // RELEASE MOD, t=0x10000, r9 c13, RGUI
+  "FFFFFFFF06000000"  // RESET, t=0xFFFFFFFF
+  "\r\n";
+
+static const char *const GOLDEN_DECODED[] = {
+  "PRESS r=2 c=5 key=4 mods=2",
+  "RELEASE r=2 c=5 key=4 mods=2",
+  "PRESS LAYER r=0 c=5 op=1 layer=1",
+  "RELEASE MOD r=9 c=13 mods=64",
+  "RESET (release all / event queue resync)",
+};
+
+static const TraceRecord GOLDEN_RECORDS[] = {
+  traceRecord(TRACE_PRESS, 2, 5, 0x04, 0x02, 0x12345678u),
+  traceRecord(TRACE_RELEASE, 2, 5, 0x04, 0x02, 0x12345700u),
+  traceRecord(TRACE_PRESS_LAYER, 0, 5, 1, 1, 1000),
+  traceRecord(TRACE_RELEASE_MOD, 9, 13, 0, 0x40, 0x10000u),
+  traceRecord(TRACE_RESET, 0, 0, 0, 0, 0xFFFFFFFFu),
+};
+
+static const uint8_t GOLDEN_COUNT = sizeof(GOLDEN_RECORDS) / sizeof(GOLDEN_RECORDS[0]);
+
+// ================================
+// Records
+// ================================
+
+void test_record_layout() {
+  uint8_t bytes[TRACE_RECORD_BYTES];
+  traceEncode(GOLDEN_RECORDS[0], bytes);
+  const uint8_t press[TRACE_RECORD_BYTES] = {0x78, 0x56, 0x34, 0x12, TRACE_PRESS, 0x25, 0x04, 0x02};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(press, bytes, TRACE_RECORD_BYTES);
+
+  traceEncode(GOLDEN_RECORDS[1], bytes);
+  const uint8_t release[TRACE_RECORD_BYTES] = {0x00, 0x57, 0x34, 0x12, TRACE_RELEASE, 0x25, 0x04, 0x02};
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(release, bytes, TRACE_RECORD_BYTES);
+}
+
+// Row and column share a byte, a nibble each
+void test_row_col_packing() {
+  TEST_ASSERT_EQUAL_HEX8(0x9D, traceRecord(TRACE_PRESS, 9, 13, 0, 0, 0).rowCol);
+  TEST_ASSERT_EQUAL_HEX8(0x0F, traceRecord(TRACE_PRESS, 0, 0x1F, 0, 0, 0).rowCol);
+}
+
+// ================================
+// Lines through the ring
+// ================================
+
+void test_line_matches_golden() {
+  static SpscQueue<TraceRecord, 8> ring;
+  for (const TraceRecord &rec : GOLDEN_RECORDS) TEST_ASSERT_TRUE(ring.push(rec));
+
+  char line[TRACE_LINE_SIZE];
+  const size_t len = traceFormatLine(ring, line);
+  TEST_ASSERT_EQUAL_UINT32(sizeof(GOLDEN_LINE) - 1, len);
+  TEST_ASSERT_EQUAL_MEMORY(GOLDEN_LINE, line, len);
+  TEST_ASSERT_TRUE(ring.empty());
+  TEST_ASSERT_EQUAL_UINT32(0, traceFormatLine(ring, line));
+
+  TEST_ASSERT_EQUAL_UINT32(GOLDEN_COUNT, sizeof(GOLDEN_DECODED) / sizeof(GOLDEN_DECODED[0]));
+}
+
+// A full ring keeps the oldest records and counts the rest; the drain
+// reports the count on its own line
+void test_overflow_drops_newest() {
+  static SpscQueue<TraceRecord, 4> ring;
+  for (uint8_t i = 0; i < GOLDEN_COUNT; ++i) ring.push(GOLDEN_RECORDS[i]);
+  TEST_ASSERT_EQUAL_UINT32(GOLDEN_COUNT - 4, ring.getStats().overflows);
+
+  char line[TRACE_LINE_SIZE];
+  const size_t len = traceFormatLine(ring, line);
+  TEST_ASSERT_EQUAL_UINT32(TRACE_PREFIX_LEN + 4 * 2 * TRACE_RECORD_BYTES + 2, len);
+  TEST_ASSERT_EQUAL_MEMORY(GOLDEN_LINE, line, len - 2);
+
+  char dropped[TRACE_DROPPED_SIZE];
+  TEST_ASSERT_EQUAL_UINT32(19, traceFormatDropped(ring.getStats().overflows, dropped));
+  TEST_ASSERT_EQUAL_STRING("[TRACE] dropped=1\r\n", dropped);
+}
+
+// More records than fit on a line carry over to the next one
+void test_line_holds_at_most_line_records() {
+  static SpscQueue<TraceRecord, 64> ring;
+  for (uint8_t i = 0; i < TRACE_LINE_RECORDS + 3; ++i) {
+    ring.push(traceRecord(TRACE_PRESS, 1, 2, 3, 4, i));
+  }
+  char line[TRACE_LINE_SIZE];
+  TEST_ASSERT_EQUAL_UINT32(TRACE_LINE_SIZE, traceFormatLine(ring, line));
+  TEST_ASSERT_EQUAL_UINT32(TRACE_PREFIX_LEN + 3 * 2 * TRACE_RECORD_BYTES + 2, traceFormatLine(ring, line));
+  TEST_ASSERT_EQUAL_MEMORY("2000000000120304", line + TRACE_PREFIX_LEN, 2 * TRACE_RECORD_BYTES);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_layout);
+  RUN_TEST(test_row_col_packing);
+  RUN_TEST(test_line_matches_golden);
+  RUN_TEST(test_overflow_drops_newest);
+  RUN_TEST(test_line_holds_at_most_line_records);
+  return UNITY_END();
+}
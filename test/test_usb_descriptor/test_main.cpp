@@ -0,0 +1,197 @@
+// test_main.cpp: keyboard endpoint lookup in full- and high-speed descriptors
+#include <string.h>
+#include <unity.h>
+#include "UsbDescriptor.h"
+
+// ================================
+// Configuration descriptors
+//
+// Serial + HID composite devices as the host receives them: CDC ACM (IAD,
+// control and data interfaces), a boot mouse, then the boot keyboard. The
+// CDC notification endpoint and the mouse are interrupt IN endpoints too,
+// so only the class/subclass/protocol match picks the keyboard's.
+// ================================
+
+#define CDC_INTERFACES(notifyInterval, bulkLo, bulkHi)                           \
+  /* Interface association: CDC, interfaces 0-1 */                             \
+  0x08, 0x0B, 0x00, 0x02, 0x02, 0x02, 0x01, 0x00,                               \
+  /* Interface 0: CDC control, 1 endpoint */                                   \
+  0x09, 0x04, 0x00, 0x00, 0x01, 0x02, 0x02, 0x01, 0x00,                         \
+  0x05, 0x24, 0x00, 0x10, 0x01,         /* header */                           \
+  0x05, 0x24, 0x01, 0x01, 0x01,         /* call management */                  \
+  0x04, 0x24, 0x02, 0x06,               /* ACM */                              \
+  0x05, 0x24, 0x06, 0x00, 0x01,         /* union */                            \
+  0x07, 0x05, 0x82, 0x03, 0x10, 0x00, notifyInterval, /* EP2 IN interrupt */   \
+  /* Interface 1: CDC data, 2 bulk endpoints */                                \
+  0x09, 0x04, 0x01, 0x00, 0x02, 0x0A, 0x00, 0x00, 0x00,                         \
+  0x07, 0x05, 0x03, 0x02, bulkLo, bulkHi, 0x00,                                 \
+  0x07, 0x05, 0x83, 0x02, bulkLo, bulkHi, 0x00
+
+#define MOUSE_INTERFACE(interval)                                                \
+  /* Interface 2: HID boot mouse (protocol 2) */                               \
+  0x09, 0x04, 0x02, 0x00, 0x01, 0x03, 0x01, 0x02, 0x00,                         \
+  0x09, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, 0x34, 0x00,                         \
+  0x07, 0x05, 0x85, 0x03, 0x08, 0x00, interval
+
+#define KEYBOARD_INTERFACE(interval)                                             \
+  /* Interface 3: HID boot keyboard (protocol 1) */                            \
+  0x09, 0x04, 0x03, 0x00, 0x01, 0x03, 0x01, 0x01, 0x00,                         \
+  0x09, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, 0x3F, 0x00,                         \
+  0x07, 0x05, 0x84, 0x03, 0x08, 0x00, interval
+
+#define CONFIG_HEADER(totalLength, interfaces) \
+  0x09, 0x02, totalLength, 0x00, interfaces, 0x01, 0x00, 0xC0, 0x32
+
+// Full speed: 64-byte bulk, keyboard polled every 1 ms frame
+static const uint8_t CONFIG_FS[] = {
+  CONFIG_HEADER(125, 4),
+  CDC_INTERFACES(64, 0x40, 0x00),
+  MOUSE_INTERFACE(1),
+  KEYBOARD_INTERFACE(1),
+};
+
+// High speed, default: 512-byte bulk, keyboard every 8 microframes (1 ms)
+static const uint8_t CONFIG_HS[] = {
+  CONFIG_HEADER(125, 4),
+  CDC_INTERFACES(5, 0x00, 0x02),
+  MOUSE_INTERFACE(4),
+  KEYBOARD_INTERFACE(4),
+};
+
+// High speed with HID_HIGH_SPEED_POLLING: keyboard every microframe
+static const uint8_t CONFIG_HS_8K[] = {
+  CONFIG_HEADER(125, 4),
+  CDC_INTERFACES(5, 0x00, 0x02),
+  MOUSE_INTERFACE(4),
+  KEYBOARD_INTERFACE(1),
+};
+
+// Keyboard with its LED OUT endpoint listed first, and a high-bandwidth
+// wMaxPacketSize (bits 11-12: extra transactions per microframe)
+static const uint8_t CONFIG_KEYBOARD_OUT_FIRST[] = {
+  CONFIG_HEADER(41, 1),
+  0x09, 0x04, 0x00, 0x00, 0x02, 0x03, 0x01, 0x01, 0x00,
+  0x09, 0x21, 0x11, 0x01, 0x00, 0x01, 0x22, 0x3F, 0x00,
+  0x07, 0x05, 0x01, 0x03, 0x08, 0x00, 0x01,   // EP1 OUT interrupt
+  0x07, 0x05, 0x81, 0x03, 0x40, 0x08, 0x01,   // EP1 IN interrupt, 64 bytes x2
+};
+
+// Serial only: no keyboard
+static const uint8_t CONFIG_SERIAL[] = {
+  CONFIG_HEADER(75, 2),
+  CDC_INTERFACES(64, 0x40, 0x00),
+};
+
+void setUp() {}
+void tearDown() {}
+
+static uint16_t totalLength(const uint8_t *cfg) {
+  return (uint16_t)(cfg[2] | (cfg[3] << 8));
+}
+
+// ================================
+// Tests
+// ================================
+
+void test_descriptors_are_well_formed() {
+  TEST_ASSERT_EQUAL_UINT16(sizeof(CONFIG_FS), totalLength(CONFIG_FS));
+  TEST_ASSERT_EQUAL_UINT16(sizeof(CONFIG_HS), totalLength(CONFIG_HS));
+  TEST_ASSERT_EQUAL_UINT16(sizeof(CONFIG_HS_8K), totalLength(CONFIG_HS_8K));
+  TEST_ASSERT_EQUAL_UINT16(sizeof(CONFIG_KEYBOARD_OUT_FIRST), totalLength(CONFIG_KEYBOARD_OUT_FIRST));
+  TEST_ASSERT_EQUAL_UINT16(sizeof(CONFIG_SERIAL), totalLength(CONFIG_SERIAL));
+}
+
+void test_full_speed_keyboard() {
+  HidEndpointInfo ep = {};
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_FS, sizeof(CONFIG_FS), ep));
+  TEST_ASSERT_EQUAL_UINT8(3, ep.interfaceNumber);
+  TEST_ASSERT_EQUAL_HEX8(0x84, ep.endpointAddress);
+  TEST_ASSERT_EQUAL_UINT16(8, ep.maxPacket);
+  TEST_ASSERT_EQUAL_UINT8(1, ep.bInterval);
+  TEST_ASSERT_EQUAL_UINT32(1000, interruptIntervalUs(ep.bInterval, false));
+}
+
+void test_high_speed_keyboard() {
+  HidEndpointInfo ep = {};
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_HS, sizeof(CONFIG_HS), ep));
+  TEST_ASSERT_EQUAL_UINT8(3, ep.interfaceNumber);
+  TEST_ASSERT_EQUAL_HEX8(0x84, ep.endpointAddress);
+  TEST_ASSERT_EQUAL_UINT8(4, ep.bInterval);
+  TEST_ASSERT_EQUAL_UINT32(1000, interruptIntervalUs(ep.bInterval, true));
+
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_HS_8K, sizeof(CONFIG_HS_8K), ep));
+  TEST_ASSERT_EQUAL_UINT8(1, ep.bInterval);
+  TEST_ASSERT_EQUAL_UINT32(USB_HS_MICROFRAME_US, interruptIntervalUs(ep.bInterval, true));
+}
+
+// The same bInterval means a different period at each speed
+void test_same_interval_differs_by_speed() {
+  HidEndpointInfo fs = {};
+  HidEndpointInfo hs = {};
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_FS, sizeof(CONFIG_FS), fs));
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_HS_8K, sizeof(CONFIG_HS_8K), hs));
+  TEST_ASSERT_EQUAL_UINT8(fs.bInterval, hs.bInterval);
+  TEST_ASSERT_EQUAL_UINT32(8 * interruptIntervalUs(hs.bInterval, true),
+                           interruptIntervalUs(fs.bInterval, false));
+}
+
+void test_out_endpoint_skipped_and_packet_size_masked() {
+  HidEndpointInfo ep = {};
+  TEST_ASSERT_TRUE(findKeyboardEndpoint(CONFIG_KEYBOARD_OUT_FIRST, sizeof(CONFIG_KEYBOARD_OUT_FIRST), ep));
+  TEST_ASSERT_EQUAL_UINT8(0, ep.interfaceNumber);
+  TEST_ASSERT_EQUAL_HEX8(0x81, ep.endpointAddress);
+  TEST_ASSERT_EQUAL_UINT16(64, ep.maxPacket);
+}
+
+void test_no_keyboard() {
+  HidEndpointInfo ep = {};
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(CONFIG_SERIAL, sizeof(CONFIG_SERIAL), ep));
+}
+
+// Short or corrupt descriptors are rejected, never read past the end
+void test_malformed_descriptors() {
+  HidEndpointInfo ep = {};
+  // Cut inside the keyboard's endpoint descriptor
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(CONFIG_FS, sizeof(CONFIG_FS) - 3, ep));
+  // Cut before the keyboard interface
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(CONFIG_FS, 100, ep));
+
+  uint8_t bad[sizeof(CONFIG_FS)];
+  memcpy(bad, CONFIG_FS, sizeof(bad));
+  bad[9] = 0;   // zero bLength on the IAD would loop forever
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(bad, sizeof(bad), ep));
+
+  memcpy(bad, CONFIG_FS, sizeof(bad));
+  bad[9] = 0xF0;   // runs past the end
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(bad, sizeof(bad), ep));
+
+  TEST_ASSERT_FALSE(findKeyboardEndpoint(CONFIG_FS, 0, ep));
+}
+
+void test_interval_encoding() {
+  TEST_ASSERT_EQUAL_UINT32(1000, interruptIntervalUs(1, false));
+  TEST_ASSERT_EQUAL_UINT32(10000, interruptIntervalUs(10, false));
+  TEST_ASSERT_EQUAL_UINT32(125, interruptIntervalUs(1, true));
+  TEST_ASSERT_EQUAL_UINT32(250, interruptIntervalUs(2, true));
+  TEST_ASSERT_EQUAL_UINT32(125u << 15, interruptIntervalUs(16, true));
+  TEST_ASSERT_EQUAL_UINT32(0, interruptIntervalUs(0, true));
+  TEST_ASSERT_EQUAL_UINT32(0, interruptIntervalUs(17, true));
+
+  TEST_ASSERT_EQUAL_UINT8(1, highSpeedInterval(125));
+  TEST_ASSERT_EQUAL_UINT8(2, highSpeedInterval(126));
+  TEST_ASSERT_EQUAL_UINT8(4, highSpeedInterval(1000));
+  TEST_ASSERT_EQUAL_UINT8(7, highSpeedInterval(8000));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_descriptors_are_well_formed);
+  RUN_TEST(test_full_speed_keyboard);
+  RUN_TEST(test_high_speed_keyboard);
+  RUN_TEST(test_same_interval_differs_by_speed);
+  RUN_TEST(test_out_endpoint_skipped_and_packet_size_masked);
+  RUN_TEST(test_no_keyboard);
+  RUN_TEST(test_malformed_descriptors);
+  RUN_TEST(test_interval_encoding);
+  return UNITY_END();
+}
@@ -0,0 +1,126 @@
+import os
+import re
+import sys
+import glob
+import struct
+import argparse
+
+# Decodes the firmware's [TRACE] lines back into the PRESS/RELEASE debug
+# lines. Reads a saved serial log (file or stdin) or a live Teensy port;
+# every other line passes through unchanged.
+#
+#   python trace_decode.py log.txt
+#   python trace_decode.py --port /dev/ttyACM0 --time
+#   python trace_decode.py --check
+
+# -------------------- FORMAT --------------------
+# Must match include/Trace.h: time_us u32, event u8, row<<4|col u8, arg0 u8, arg1 u8
+RECORD = struct.Struct("<IBBBB")
+PREFIX = "[TRACE] "
+
+def format_record(event, row, col, arg0, arg1):
+    if event == 0:
+        return f"PRESS r={row} c={col} key={arg0} mods={arg1}"
+    if event == 1:
+        return f"RELEASE r={row} c={col} key={arg0} mods={arg1}"
+    if event == 2:
+        return f"PRESS MOD r={row} c={col} mods={arg1}"
+    if event == 3:
+        return f"RELEASE MOD r={row} c={col} mods={arg1}"
+    if event == 4:
+        return f"PRESS LAYER r={row} c={col} op={arg0} layer={arg1}"
+    if event == 5:
+        return f"RELEASE LAYER r={row} c={col} op={arg0} layer={arg1}"
+    if event == 6:
+        return "RESET (release all / event queue resync)"
+    return f"UNKNOWN event={event} r={row} c={col} arg0={arg0} arg1={arg1}"
+
+def decode_line(line, show_time):
+    """Returns the output lines for one input line."""
+    if not line.startswith(PREFIX):
+        return [line]
+    payload = line[len(PREFIX):].strip()
+    if payload.startswith("dropped="):
+        return [f"[TRACE] {payload.split('=', 1)[1]} records dropped (ring full)"]
+    try:
+        data = bytes.fromhex(payload)
+    except ValueError:
+        return [f"[TRACE] undecodable: {payload}"]
+
+    out = []
+    for i in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        time_us, event, row_col, arg0, arg1 = RECORD.unpack_from(data, i)
+        text = format_record(event, row_col >> 4, row_col & 0x0F, arg0, arg1)
+        out.append(f"[{time_us:>10} us] {text}" if show_time else text)
+    return out
+
+# -------------------- SELF CHECK --------------------
+# test/test_trace encodes GOLDEN_LINE from records; --check decodes the same
+# line and compares it with GOLDEN_DECODED from that file
+GOLDEN_SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "test", "test_trace", "test_main.cpp")
+
+def c_strings(source, name):
+    """The string literals of one C initializer, comments dropped."""
+    body = re.search(re.escape(name) + r"\[\]\s*=(.*?);", source, re.S).group(1)
+    body = re.sub(r"//[^\n]*", "", body)
+    return re.findall(r'"((?:[^"\\]|\\.)*)"', body)
+
+def check():
+    source = open(GOLDEN_SOURCE).read()
+    line = "".join(c_strings(source, "GOLDEN_LINE")).replace("\\r\\n", "")
+    expected = c_strings(source, "GOLDEN_DECODED")
+    decoded = decode_line(line, False)
+    if decoded != expected:
+        print("[TRACE] decode check FAILED")
+        for i in range(max(len(expected), len(decoded))):
+            want = expected[i] if i < len(expected) else "(none)"
+            got = decoded[i] if i < len(decoded) else "(none)"
+            if want != got:
+                print(f"  expected: {want}\n  decoded:  {got}")
+        return False
+    print(f"[TRACE] decode check OK ({len(decoded)} records)")
+    return True
+
+def find_port():
+    ports = glob.glob("/dev/cu.usbmodem*") + glob.glob("/dev/ttyACM*") + glob.glob("COM*")
+    return ports[0] if ports else None
+
+def lines_from_serial(port, baud):
+    import serial
+    with serial.Serial(port=port, baudrate=baud, timeout=1) as ser:
+        while True:
+            raw = ser.readline()
+            if raw:
+                yield raw.decode("utf-8", errors="ignore").rstrip("\r\n")
+
+def lines_from_file(f):
+    for raw in f:
+        yield raw.rstrip("\r\n")
+
+parser = argparse.ArgumentParser(description="Decode [TRACE] lines from the keyboard firmware")
+parser.add_argument("log", nargs="?", help="Saved serial log (default: stdin, unless --port)")
+parser.add_argument("--port", help="Read a live serial port instead ('auto' to pick the first Teensy)")
+parser.add_argument("--baud", type=int, default=115200, help="Serial baud rate (USB serial ignores it)")
+parser.add_argument("--time", action="store_true", help="Prefix each event with its timestamp")
+parser.add_argument("--check", action="store_true", help="Decode test_trace's golden line and compare")
+args = parser.parse_args()
+
+if args.check:
+    sys.exit(0 if check() else 1)
+elif args.port:
+    port = find_port() if args.port == "auto" else args.port
+    if not port:
+        print("[TRACE] No Teensy serial port found!")
+        sys.exit(1)
+    source = lines_from_serial(port, args.baud)
+elif args.log:
+    source = lines_from_file(open(args.log, "r", errors="ignore"))
+else:
+    source = lines_from_file(sys.stdin)
+
+try:
+    for line in source:
+        for out in decode_line(line, args.time):
+            print(out, flush=True)
+except KeyboardInterrupt:
+    pass